@@ -1,103 +1,475 @@
 #include "clock.h"
 
+#include "dac.h"
+#include "engine.h"
+#include "pitch.h"
+#include "trace.h"
+
 #include "hardware/timer.h"
 #include "hardware/gpio.h"
-#include "hardware/spi.h"
 #include "pico/multicore.h"
 #include "pico/stdlib.h"
+#include <atomic>
+#include <cstdio>
 
 namespace {
-volatile uint64_t us_counter = 0;
-volatile uint32_t clock_interval_us = 5000;
-volatile bool tick_flag = false;
-
-constexpr uint GATE_PIN = 6;
-volatile bool gate_active = false;
-volatile uint64_t gate_start_us = 0;
-volatile uint64_t gate_duration_us = 0;
-volatile bool gate_enabled = false;
-
-constexpr uint DAC_CS_PIN = 17;
-
-struct repeating_timer timer_state;
-
-bool timer_callback(struct repeating_timer *t) {
-    us_counter += 100;
-
-    if (us_counter >= clock_interval_us) {
-        us_counter = 0;
-        tick_flag = true;
-        
-        if (gate_enabled && !gate_active) {
-            gpio_put(GATE_PIN, true);
-            gate_active = true;
-            gate_start_us = time_us_64();
-            gate_duration_us = clock_interval_us / 2;
+// Tick interval in microseconds as 32.32 fixed point. Core1 only: tempo
+// changes arrive as engine commands.
+uint64_t interval_fp = 5000ULL << 32;
+
+// One gate output per track. Edges due at the same microsecond switch
+// together through the SIO set and clear registers.
+constexpr uint GATE_PINS[ENGINE_TRACKS] = {6, 20, 21, 22};
+
+// Tick deadlines advance from the previous deadline, not from the time the
+// step was evaluated, so latency never accumulates into tempo drift. A step
+// is evaluated half a step before its deadline, the earliest its outputs
+// can be due (an offset of -50%), plus the CV lead.
+uint64_t next_tick_us = 0;
+uint32_t next_tick_frac = 0;  // fractional microseconds of the next deadline
+
+ClockOverrunPolicy overrun_policy = CLOCK_OVERRUN_CATCH_UP;
+// core0's copy of the last policy posted, for the console toggle.
+ClockOverrunPolicy posted_policy = CLOCK_OVERRUN_CATCH_UP;
+
+// Output scheduler. core1's thread turns each step into timed outputs (the
+// CV write, a gate-on and a gate-off per ratchet per track, and the report
+// to core0) and queues them in a min-heap by time. One hardware alarm is
+// armed for the earliest; its IRQ only pops what is due and drives the
+// pins and the DAC, so evaluating a step never delays an edge. The thread
+// pushes with the IRQ masked, one event at a time.
+//
+// The CV write is queued CV_LEAD_US ahead of the step, so both frames are
+// clocked out and latched, and the output has settled, before its gate
+// rises. At equal times the kind decides: a gate rising where the previous
+// one ends ties the two (the earlier gate-off no longer matches and is
+// ignored), and the report goes last.
+enum TimedKind : uint8_t { TIMED_CV, TIMED_GATE_ON, TIMED_GATE_OFF, TIMED_REPORT };
+
+struct Timed {
+    uint64_t time_us;
+    TimedKind kind;
+    uint8_t track;
+    uint8_t gate;  // GATE_ON/OFF: serial of the gate-on, per track
+    uint16_t cv_a;
+    uint16_t cv_b;
+};
+
+// A step's events fall within two steps of its evaluation, so three steps
+// are queued at most; the fourth is headroom for catching up after an
+// overrun.
+// Two 16-bit frames at 8 MHz take 4 us on the wire, CS gaps included with
+// margin; the MCP4822 then settles in 4.5 us.
+constexpr uint32_t CV_LEAD_US = 10;
+
+constexpr uint32_t TIMED_PER_STEP = 2 + 2 * ENGINE_TRACKS * ENGINE_RATCHETS_MAX;
+constexpr uint32_t QUEUE_CAPACITY = 4 * TIMED_PER_STEP;
+Timed queue[QUEUE_CAPACITY];
+uint32_t queue_size = 0;
+
+uint alarm_num = 0;
+uint8_t gate_serial[ENGINE_TRACKS] = {0};  // thread: last gate-on queued
+uint8_t gate_owner[ENGINE_TRACKS] = {0};   // IRQ: last gate-on played
+
+// What core0 hears at a tick's grid time. Reports are queued in deadline
+// order and fire in that order; evaluation runs at most half a step ahead,
+// so a couple of slots suffice.
+struct Report {
+    uint64_t time_us;
+    bool overrun;
+    uint8_t skipped;
+    bool stepped;
+    EngineEvent step;
+};
+constexpr uint32_t REPORT_SLOTS = 4;
+Report reports[REPORT_SLOTS];
+uint32_t reports_queued = 0;  // written by the thread, IRQ masked
+uint32_t reports_fired = 0;   // written by the IRQ
+
+// Tick accounting, written by core1 only and read by core0.
+std::atomic<uint32_t> ticks_produced{0};
+std::atomic<uint32_t> ticks_missed{0};
+std::atomic<uint32_t> ticks_skipped{0};
+std::atomic<uint32_t> outputs_dropped{0};
+std::atomic<uint32_t> max_tick_latency_us{0};
+std::atomic<uint32_t> max_output_latency_us{0};
+
+void count(std::atomic<uint32_t>& counter, uint32_t n = 1) {
+    counter.store(counter.load() + n);
+}
+
+void track_max(std::atomic<uint32_t>& counter, uint64_t value) {
+    if (value > counter.load()) counter.store((uint32_t)value);
+}
+
+bool earlier(const Timed& a, const Timed& b) {
+    return a.time_us != b.time_us ? a.time_us < b.time_us : a.kind < b.kind;
+}
+
+void queue_push(const Timed& ev) {
+    uint32_t i = queue_size++;
+    while (i > 0) {
+        uint32_t parent = (i - 1) / 2;
+        if (!earlier(ev, queue[parent])) break;
+        queue[i] = queue[parent];
+        i = parent;
+    }
+    queue[i] = ev;
+}
+
+Timed queue_pop() {
+    Timed top = queue[0];
+    Timed last = queue[--queue_size];
+    uint32_t i = 0;
+    while (true) {
+        uint32_t child = 2 * i + 1;
+        if (child >= queue_size) break;
+        if (child + 1 < queue_size && earlier(queue[child + 1], queue[child])) child++;
+        if (!earlier(queue[child], last)) break;
+        queue[i] = queue[child];
+        i = child;
+    }
+    queue[i] = last;
+    return top;
+}
+
+// Arm the alarm for the head of the queue. hardware_alarm_set_target()
+// returns true if that time has already passed; the IRQ is then raised by
+// hand.
+void arm_alarm() {
+    if (queue_size == 0) return;
+    if (hardware_alarm_set_target(alarm_num, from_us_since_boot(queue[0].time_us)))
+        hardware_alarm_force_irq(alarm_num);
+}
+
+// Thread side. Returns false if the queue is full (the event is dropped).
+bool schedule(const Timed& ev) {
+    uint32_t save = save_and_disable_interrupts();
+    bool room = queue_size < QUEUE_CAPACITY;
+    if (room) {
+        bool head = queue_size == 0 || earlier(ev, queue[0]);
+        queue_push(ev);
+        if (head) arm_alarm();
+    } else {
+        count(outputs_dropped);
+    }
+    restore_interrupts(save);
+    return room;
+}
+
+void schedule_gate(uint8_t track, uint64_t on_us, uint32_t length_us) {
+    Timed ev = {};
+    ev.track = track;
+    ev.gate = ++gate_serial[track];
+    ev.time_us = on_us;
+    ev.kind = TIMED_GATE_ON;
+    schedule(ev);
+    ev.time_us = on_us + length_us;
+    ev.kind = TIMED_GATE_OFF;
+    schedule(ev);
+}
+
+// Queue the outputs of a step due at `grid_us`. The offset moves the whole
+// step; ratchets split it evenly and the gate length applies to each.
+void schedule_step(const SeqStep& step, uint64_t grid_us) {
+    uint32_t interval = (uint32_t)(interval_fp >> 32);
+    for (uint8_t t = 0; t < ENGINE_TRACKS; t++) {
+        uint64_t start = grid_us + (int64_t)interval * step.offset[t] / 100;
+        if (t == 0) {
+            // Both CV lanes of track 0 go out in one burst, ahead of its
+            // first gate.
+            Timed cv = {};
+            cv.time_us = start - CV_LEAD_US;
+            cv.kind = TIMED_CV;
+            cv.cv_a = pitch_dac(step.note[0]);
+            cv.cv_b = step.cv_b[0];
+            schedule(cv);
         }
+        if (!(step.gates & (1u << t))) continue;
+
+        uint32_t spacing = interval / step.ratchets[t];
+        uint32_t length = spacing * step.gate_len[t] / 100;
+        if (length == 0) length = 1;
+        for (uint8_t r = 0; r < step.ratchets[t]; r++)
+            schedule_gate(t, start + r * spacing, length);
     }
-    
-    if (gate_active) {
+}
+
+// The report is queued with its slot filled in, under one mask, so the IRQ
+// never sees a queued report that is not there yet.
+void schedule_report(const Report& report) {
+    uint32_t save = save_and_disable_interrupts();
+    if (reports_queued - reports_fired < REPORT_SLOTS && queue_size < QUEUE_CAPACITY) {
+        reports[reports_queued % REPORT_SLOTS] = report;
+        reports_queued++;
+        Timed ev = {};
+        ev.time_us = report.time_us;
+        ev.kind = TIMED_REPORT;
+        bool head = queue_size == 0 || earlier(ev, queue[0]);
+        queue_push(ev);
+        if (head) arm_alarm();
+    } else {
+        count(outputs_dropped);
+    }
+    restore_interrupts(save);
+}
+
+// IRQ side.
+void set_gates(uint32_t raise, uint32_t lower) {
+    if (raise) {
+        gpio_set_mask(raise);
+        TRACE_EVENT(TRACE_GATE_ON);
+    }
+    if (lower) {
+        gpio_clr_mask(lower);
+        TRACE_EVENT(TRACE_GATE_OFF);
+    }
+}
+
+void fire_report(uint64_t now_us) {
+    const Report& report = reports[reports_fired % REPORT_SLOTS];
+    TRACE_TICK_START(report.time_us);
+    track_max(max_tick_latency_us, now_us - report.time_us);
+    if (report.overrun) {
+        EngineEvent overrun = {};
+        overrun.time_us = report.time_us;
+        overrun.type = ENGINE_EVT_OVERRUN;
+        overrun.count = report.skipped;
+        engine_emit(overrun);
+    }
+    count(ticks_produced);
+    EngineEvent tick = {};
+    tick.time_us = report.time_us;
+    tick.type = ENGINE_EVT_TICK;
+    engine_emit(tick);
+    if (report.stepped) engine_emit(report.step);
+    reports_fired++;
+}
+
+// Play every event due by now. Gate edges sharing a timestamp go out as one
+// batch, in a single set and clear.
+void run_due_events() {
+    while (queue_size > 0) {
         uint64_t now_us = time_us_64();
-        if ((now_us - gate_start_us) >= gate_duration_us) {
-            gpio_put(GATE_PIN, false);
-            gate_active = false;
+        uint64_t due_us = queue[0].time_us;
+        if (due_us > now_us) return;
+        track_max(max_output_latency_us, now_us - due_us);
+
+        uint32_t raise = 0, lower = 0;
+        while (queue_size > 0 && queue[0].time_us == due_us) {
+            Timed ev = queue_pop();
+            switch (ev.kind) {
+            case TIMED_CV:
+                dac_write_both(ev.cv_a, ev.cv_b);
+                TRACE_CV_DONE(due_us);
+                break;
+            case TIMED_GATE_ON:
+                raise |= 1u << GATE_PINS[ev.track];
+                gate_owner[ev.track] = ev.gate;
+                break;
+            case TIMED_GATE_OFF:
+                if (gate_owner[ev.track] == ev.gate) lower |= 1u << GATE_PINS[ev.track];
+                break;
+            case TIMED_REPORT:
+                // Reports sort last: the edges come out first.
+                set_gates(raise, lower);
+                raise = lower = 0;
+                fire_report(now_us);
+                break;
+            }
+        }
+        set_gates(raise, lower);
+    }
+}
+
+void alarm_callback(uint alarm) {
+    // hardware_alarm_set_target() returns true if the deadline has already
+    // passed, in which case the event is handled here instead of by an IRQ.
+    do {
+        run_due_events();
+        if (queue_size == 0) break;
+    } while (hardware_alarm_set_target(alarm, from_us_since_boot(queue[0].time_us)));
+}
+
+// Phase accumulator: the fraction carries into the integer deadline, so
+// truncation never accumulates.
+void advance_deadline() {
+    uint64_t frac = (uint64_t)next_tick_frac + (uint32_t)interval_fp;
+    next_tick_us += (interval_fp >> 32) + (frac >> 32);
+    next_tick_frac = (uint32_t)frac;
+}
+
+uint64_t following_deadline() {
+    return next_tick_us + (interval_fp >> 32) +
+           (((uint64_t)next_tick_frac + (uint32_t)interval_fp) >> 32);
+}
+
+uint64_t lead_us() {
+    return (interval_fp >> 33) + CV_LEAD_US;
+}
+
+// A step is overrun when it is evaluated after the following step was due
+// to be. `due_us` is the evaluation time shifted by the lead, comparable
+// with the deadlines.
+void handle_overrun(uint64_t due_us, Report* report) {
+    count(ticks_missed);
+    report->overrun = true;
+    if (overrun_policy == CLOCK_OVERRUN_SKIP) {
+        uint32_t skipped = 0;
+        while (due_us >= following_deadline()) {
+            advance_deadline();
+            skipped++;
+        }
+        count(ticks_skipped, skipped);
+        engine_skip(skipped);
+        report->skipped = (uint8_t)(skipped > 255 ? 255 : skipped);
+    }
+}
+
+// Thread side: run the engine for the next tick and queue its outputs.
+void evaluate_step(uint64_t now_us) {
+    Report report = {};
+    uint64_t due_us = now_us + lead_us();
+    if (due_us >= following_deadline()) handle_overrun(due_us, &report);
+
+    report.time_us = next_tick_us;
+    SeqStep step;
+    report.stepped = engine_tick(next_tick_us, &step, &report.step);
+    if (report.stepped) schedule_step(step, next_tick_us);
+    schedule_report(report);
+    advance_deadline();
+}
+
+void set_tempo(uint32_t centi_bpm) {
+    if (centi_bpm == 0) centi_bpm = 12000;
+    // 16th-note interval: 60e6 us * 100 / (centi_bpm * 4), rounded.
+    constexpr uint64_t US_PER_16TH_CENTI = 1'500'000'000ULL;
+    interval_fp = ((US_PER_16TH_CENTI << 32) + centi_bpm / 2) / centi_bpm;
+}
+
+// Apply queued commands. They run in the thread, between step evaluations;
+// the output IRQ never touches engine state.
+void service_commands() {
+    EngineCommand cmd;
+    while (engine_pop_command(&cmd)) {
+        switch (cmd.type) {
+        case ENGINE_CMD_SET_TEMPO:
+            set_tempo(cmd.centi_bpm);
+            break;
+        case ENGINE_CMD_SET_OVERRUN_POLICY:
+            overrun_policy = (ClockOverrunPolicy)cmd.value;
+            break;
+        case ENGINE_CMD_RESET_STATS: {
+            // The IRQ updates these counters as well.
+            uint32_t save = save_and_disable_interrupts();
+            ticks_produced.store(0);
+            ticks_missed.store(0);
+            ticks_skipped.store(0);
+            outputs_dropped.store(0);
+            max_tick_latency_us.store(0);
+            max_output_latency_us.store(0);
+            engine_apply(cmd);
+            restore_interrupts(save);
+            break;
+        }
+        default:
+            engine_apply(cmd);
+            break;
         }
     }
-    
-    return true;
 }
 
 void core1_main() {
-    gpio_init(GATE_PIN);
-    gpio_set_dir(GATE_PIN, GPIO_OUT);
-    gpio_put(GATE_PIN, false);
-    
-    spi_init(spi0, 8000000);
-    gpio_set_function(18, GPIO_FUNC_SPI);
-    gpio_set_function(19, GPIO_FUNC_SPI);
+    for (uint pin : GATE_PINS) {
+        gpio_init(pin);
+        gpio_set_dir(pin, GPIO_OUT);
+        gpio_put(pin, false);
+    }
     
-    gpio_init(DAC_CS_PIN);
-    gpio_set_dir(DAC_CS_PIN, GPIO_OUT);
-    gpio_put(DAC_CS_PIN, true);
+    dac_init();
     
-    add_repeating_timer_us(-100, timer_callback, nullptr, &timer_state);
+    service_commands();
+    // The alarm IRQ is enabled on the core that installs the callback.
+    alarm_num = (uint)hardware_alarm_claim_unused(true);
+    hardware_alarm_set_callback(alarm_num, alarm_callback);
+    next_tick_us = time_us_64() + (interval_fp >> 32);
     
     while (true) {
+        service_commands();
+        uint64_t now_us = time_us_64();
+        if (now_us + lead_us() >= next_tick_us) evaluate_step(now_us);
         tight_loop_contents();
     }
 }
 } // namespace
 
 void clock_set_bpm(uint32_t bpm) {
-    uint64_t us_per_quarter = 60000000ULL / (bpm ? bpm : 120);
-    clock_interval_us = static_cast<uint32_t>(us_per_quarter / 4);
+    clock_set_bpm_centi((bpm ? bpm : 120) * 100);
+}
+
+void clock_set_bpm_centi(uint32_t centi_bpm) {
+    EngineCommand cmd = {};
+    cmd.type = ENGINE_CMD_SET_TEMPO;
+    cmd.centi_bpm = centi_bpm;
+    engine_post(cmd);
 }
 
 void clock_launch_core1() {
     multicore_launch_core1(core1_main);
 }
 
-bool clock_consume_tick() {
-    if (!tick_flag) return false;
-    tick_flag = false;
-    return true;
+void clock_set_overrun_policy(ClockOverrunPolicy policy) {
+    EngineCommand cmd = {};
+    cmd.type = ENGINE_CMD_SET_OVERRUN_POLICY;
+    cmd.value = policy;
+    engine_post(cmd);
+    posted_policy = policy;
 }
 
-void clock_gate_enable(bool enable) {
-    gate_enabled = enable;
+void clock_get_stats(ClockStats* stats) {
+    stats->ticks_produced = ticks_produced.load();
+    stats->ticks_consumed = engine_ticks_consumed();
+    stats->ticks_missed = ticks_missed.load();
+    stats->ticks_skipped = ticks_skipped.load();
+    stats->events_dropped = engine_events_dropped();
+    stats->outputs_dropped = outputs_dropped.load();
+    stats->max_tick_latency_us = max_tick_latency_us.load();
+    stats->max_output_latency_us = max_output_latency_us.load();
+    stats->max_consume_latency_us = engine_max_consume_latency_us();
 }
 
-void clock_set_cv(uint16_t dac_val) {
-    uint32_t save = save_and_disable_interrupts();
-    
-    if (dac_val > 0x0FFF) dac_val = 0x0FFF;
-    
-    uint16_t command = 0x1000 | (dac_val & 0x0FFF);
-    uint8_t buf[2] = {(uint8_t)(command >> 8), (uint8_t)(command & 0xFF)};
-    
-    gpio_put(DAC_CS_PIN, false);
-    spi_write_blocking(spi0, buf, 2);
-    gpio_put(DAC_CS_PIN, true);
-    
-    restore_interrupts(save);
+void clock_reset_stats() {
+    engine_reset_consume_stats();
+    EngineCommand cmd = {};
+    cmd.type = ENGINE_CMD_RESET_STATS;
+    engine_post(cmd);
+}
+
+bool clock_command(int c) {
+    if (c == 'k') {
+        ClockStats stats;
+        clock_get_stats(&stats);
+        printf("clock %s ticks %lu/%lu missed %lu skipped %lu dropped events %lu"
+               " outputs %lu; max latency tick %lu output %lu consume %lu us\n",
+               posted_policy == CLOCK_OVERRUN_SKIP ? "skip" : "catch-up",
+               (unsigned long)stats.ticks_produced, (unsigned long)stats.ticks_consumed,
+               (unsigned long)stats.ticks_missed, (unsigned long)stats.ticks_skipped,
+               (unsigned long)stats.events_dropped, (unsigned long)stats.outputs_dropped,
+               (unsigned long)stats.max_tick_latency_us,
+               (unsigned long)stats.max_output_latency_us,
+               (unsigned long)stats.max_consume_latency_us);
+        return true;
+    }
+    if (c == 'K') {
+        clock_reset_stats();
+        return true;
+    }
+    if (c == 'O') {
+        clock_set_overrun_policy(posted_policy == CLOCK_OVERRUN_SKIP ? CLOCK_OVERRUN_CATCH_UP
+                                                                     : CLOCK_OVERRUN_SKIP);
+        printf("clock overrun policy %s\n",
+               posted_policy == CLOCK_OVERRUN_SKIP ? "skip" : "catch-up");
+        return true;
+    }
+    return false;
 }
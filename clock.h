@@ -5,14 +5,45 @@
 // Configure clock interval based on BPM and PPQN.
 void clock_set_bpm(uint32_t bpm);
 
-// Launch the timing core (core1) that generates ticks.
+// Same in hundredths of a BPM (12025 = 120.25 BPM). The interval is kept as
+// 32.32 fixed-point microseconds and accumulated as a phase, so tempo does
+// not drift over a long run.
+void clock_set_bpm_centi(uint32_t centi_bpm);
+
+// Launch the timing core (core1). Half a step before each tick its thread
+// runs the sequencer engine and schedules the step's outputs: the CV write
+// and every gate edge, placed to the microsecond by gate length, ratchets
+// and offset. A hardware alarm plays them back from a time-ordered queue.
+// Ticks are reported to core0 as engine events at their grid time.
 void clock_launch_core1();
 
-// Check and clear a pending tick produced by core1.
-bool clock_consume_tick();
+// What core1 does when it finds a tick deadline already overtaken by the
+// next one (the step was evaluated more than a step late):
+// CATCH_UP plays every missed step back to back; SKIP drops the missed
+// ticks but advances the play position with them, so the sequence stays in
+// phase with the tick grid.
+enum ClockOverrunPolicy : uint8_t { CLOCK_OVERRUN_CATCH_UP, CLOCK_OVERRUN_SKIP };
+void clock_set_overrun_policy(ClockOverrunPolicy policy);
+
+struct ClockStats {
+    uint32_t ticks_produced;          // tick events emitted by core1
+    uint32_t ticks_consumed;          // tick events drained by core0
+    uint32_t ticks_missed;            // ticks run after the next deadline
+    uint32_t ticks_skipped;           // ticks dropped by the skip policy
+    uint32_t events_dropped;          // events lost to a full event ring
+    uint32_t outputs_dropped;         // gate/CV edges lost to a full queue
+    uint32_t max_tick_latency_us;     // deadline to tick report, core1
+    uint32_t max_output_latency_us;   // scheduled to actual gate/CV edge
+    uint32_t max_consume_latency_us;  // deadline to core0 pickup
+};
 
-// Enable/disable gate output (call when play/pause)
-void clock_gate_enable(bool enable);
+// Snapshot the timing counters (call from core0). After a soak run with
+// ticks_missed, ticks_skipped, events_dropped and outputs_dropped at zero,
+// no step was lost.
+void clock_get_stats(ClockStats* stats);
+void clock_reset_stats();
 
-// Set CV/DAC value (updated on next tick by core 1)
-void clock_set_cv(uint16_t dac_value);
+// Console commands: 'k' prints the counters and the overrun policy, 'K'
+// resets the counters, 'O' switches between catch-up and skip.
+// Returns true if `c` was handled.
+bool clock_command(int c);
@@ -0,0 +1,81 @@
+#include "dac.h"
+
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/spi.h"
+
+namespace {
+constexpr uint DAC_SCK_PIN = 18;
+constexpr uint DAC_MOSI_PIN = 19;
+constexpr uint DAC_CS_PIN = 17;
+constexpr uint DAC_BAUD = 8000000;
+
+// MCP4822 frame: channel select in bit 15, 2x gain (bit 13 clear), active
+// (bit 12 set), then the 12-bit code.
+constexpr uint16_t FRAME_CHANNEL_A = 0x1000;
+constexpr uint16_t FRAME_CHANNEL_B = 0x9000;
+
+int dma_chan = -1;
+
+// Codes waiting for the next burst, one bit per channel in staged_mask.
+// burst[] belongs to the DMA while a transfer is in flight.
+uint16_t staged_code[2] = {0, 0};
+uint8_t staged_mask = 0;
+uint16_t burst[2];
+
+void start_burst() {
+    if (staged_mask == 0 || dma_channel_is_busy(dma_chan)) return;
+
+    uint32_t frames = 0;
+    if (staged_mask & (1u << DAC_CHANNEL_A))
+        burst[frames++] = FRAME_CHANNEL_A | staged_code[DAC_CHANNEL_A];
+    if (staged_mask & (1u << DAC_CHANNEL_B))
+        burst[frames++] = FRAME_CHANNEL_B | staged_code[DAC_CHANNEL_B];
+    staged_mask = 0;
+    dma_channel_transfer_from_buffer_now(dma_chan, burst, frames);
+}
+
+void dma_done_irq() {
+    dma_channel_acknowledge_irq1(dma_chan);
+    start_burst();
+}
+
+void stage(DacChannel channel, uint16_t code) {
+    staged_code[channel] = code & 0x0FFF;
+    staged_mask |= 1u << channel;
+}
+} // namespace
+
+void dac_init() {
+    spi_init(spi0, DAC_BAUD);
+    spi_set_format(spi0, 16, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST);
+    gpio_set_function(DAC_SCK_PIN, GPIO_FUNC_SPI);
+    gpio_set_function(DAC_MOSI_PIN, GPIO_FUNC_SPI);
+    gpio_set_function(DAC_CS_PIN, GPIO_FUNC_SPI);
+
+    dma_chan = dma_claim_unused_channel(true);
+    dma_channel_config cfg = dma_channel_get_default_config(dma_chan);
+    channel_config_set_transfer_data_size(&cfg, DMA_SIZE_16);
+    channel_config_set_read_increment(&cfg, true);
+    channel_config_set_write_increment(&cfg, false);
+    channel_config_set_dreq(&cfg, spi_get_dreq(spi0, true));
+    dma_channel_configure(dma_chan, &cfg, &spi_get_hw(spi0)->dr, burst, 0,
+                          false);
+
+    // DMA_IRQ_0 is left to core0; the display flush is polled anyway.
+    dma_channel_set_irq1_enabled(dma_chan, true);
+    irq_set_exclusive_handler(DMA_IRQ_1, dma_done_irq);
+    irq_set_enabled(DMA_IRQ_1, true);
+}
+
+void dac_write(DacChannel channel, uint16_t code) {
+    stage(channel, code);
+    start_burst();
+}
+
+void dac_write_both(uint16_t code_a, uint16_t code_b) {
+    stage(DAC_CHANNEL_A, code_a);
+    stage(DAC_CHANNEL_B, code_b);
+    start_burst();
+}
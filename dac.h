@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+
+// MCP4822 driver on SPI0 (SCK GP18, MOSI GP19, CS GP17). The SPI block
+// drives CS itself: in 16-bit Motorola mode with CPHA 0 it pulses CS
+// between frames, which is the per-frame latch the DAC needs. Frames are
+// fed to the TX FIFO by DMA, so a write only queues the new code and
+// returns; it never waits on the bus and never masks interrupts.
+//
+// Core1 only. The writes and the DMA completion IRQ run at the same
+// priority as the tick alarm, so they never preempt each other.
+
+enum DacChannel : uint8_t { DAC_CHANNEL_A, DAC_CHANNEL_B };
+
+// Configure SPI0, the pins and a DMA channel. Call on core1 before the
+// tick alarm is armed: the completion IRQ is enabled on the calling core.
+void dac_init();
+
+// Queue a 12-bit code for one channel. If a burst is still in flight the
+// code is held (latest wins) and sent when that burst completes.
+void dac_write(DacChannel channel, uint16_t code);
+
+// Update both channels in one two-frame burst.
+void dac_write_both(uint16_t code_a, uint16_t code_b);
@@ -5,16 +5,640 @@
 #include "pico/stdlib.h"
 #include <cstring>
 
+#ifndef SEQ_EEPROM_SIZE
+#define SEQ_EEPROM_SIZE 2048
+#endif
+
 namespace {
 constexpr uint8_t EEPROM_BASE_ADDR = 0x50;
 constexpr uint SDA_PIN = 26;
 constexpr uint SCL_PIN = 27;
-constexpr uint8_t PATTERN_STORAGE_SIZE = 19;
-constexpr uint8_t NUM_PATTERNS = 10;
-constexpr uint8_t MAGIC_BYTE = 0xAA;
-constexpr uint16_t MAGIC_ADDR = 1900;
+constexpr uint32_t EEPROM_SIZE = SEQ_EEPROM_SIZE;
+static_assert(EEPROM_SIZE >= 2048 && EEPROM_SIZE <= 65536 && (EEPROM_SIZE & (EEPROM_SIZE - 1)) == 0,
+              "SEQ_EEPROM_SIZE must be a 24Cxx size from 2 KB to 64 KB");
+// 24C32 and up take a two-byte word address; the 24C16 takes one, with
+// the upper bits as block select in the device address.
+constexpr bool WIDE_ADDRESS = EEPROM_SIZE > 2048;
+constexpr uint8_t PAGE_SIZE = 16;                    // smallest write page of the family
+constexpr uint64_t WRITE_CYCLE_TIMEOUT_US = 10'000;  // tWR is 5 ms max
+
+// Record ids. A page is stored as up to six parts: track 0 notes, gates
+// and length; lane B steps 0..7; lane B steps 8..15; the gates and lengths
+// of the other tracks; track 0 step timing for steps 0..7 and 8..15. The
+// first ids keep the numbering of the 10-slot, 16-step store, so existing
+// chips load unchanged: 0..9 notes of slots 0..9, 10 the pitch
+// calibration, 11..30 lane B halves, 31..40 track gates. Every other
+// (slot, page, part) of the first four parts is numbered from 41 on,
+// followed by the song chain, then by the timing parts.
+enum PagePart : uint8_t {
+    PART_NOTES,
+    PART_CV_LO,
+    PART_CV_HI,
+    PART_TRACKS,
+    PART_TIMING_LO,
+    PART_TIMING_HI,
+    NUM_PARTS
+};
+constexpr uint8_t PAGE_PARTS = PART_TIMING_LO;  // parts numbered before the chain
+constexpr uint8_t TIMING_PARTS = NUM_PARTS - PAGE_PARTS;
+constexpr uint8_t V1_SLOTS = 10;
+constexpr uint16_t CALIBRATION_ID = V1_SLOTS;
+constexpr uint16_t V1_CV_B_ID = CALIBRATION_ID + 1;
+constexpr uint16_t V1_TRACKS_ID = V1_CV_B_ID + 2 * V1_SLOTS;
+constexpr uint16_t PAGE_ID_BASE = V1_TRACKS_ID + V1_SLOTS;
+constexpr uint16_t CHAIN_ID_BASE = PAGE_ID_BASE + EEPROM_PATTERN_SLOTS * EEPROM_PAGES * PAGE_PARTS;
+constexpr uint8_t CHAIN_RECORDS = 2;
+constexpr uint16_t TIMING_ID_BASE = CHAIN_ID_BASE + CHAIN_RECORDS;
+constexpr uint16_t NUM_RECORD_IDS = TIMING_ID_BASE + EEPROM_PATTERN_SLOTS * EEPROM_PAGES * TIMING_PARTS;
+constexpr uint8_t CV_B_STEPS_PER_RECORD = EEPROM_PAGE_STEPS / 2;
+constexpr uint8_t TIMING_STEPS_PER_RECORD = EEPROM_PAGE_STEPS / 2;
+
+// Legacy fixed-slot layout (slot * 19, marker byte at 1900), imported into
+// the record store at boot while the marker is set. The legacy bytes and the
+// marker occupy these record positions until records are written over them.
+constexpr uint8_t LEGACY_PATTERN_SIZE = 19;
+constexpr uint8_t LEGACY_MAGIC_BYTE = 0xAA;
+constexpr uint16_t LEGACY_MAGIC_ADDR = 1900;
+
+// Log-structured record store. The chip is an array of 32-byte (two-page)
+// records, appended round-robin:
+//   [0] tag  [1] id (low byte)  [2..3] sequence (LE)  [4..22] payload
+//   [23] id high byte, inverted (erased 0xFF reads as 0)
+//   [24..29] 0xFF               [30..31] CRC-16/CCITT over bytes 0..29
+// The newest valid record of an id wins. A torn write fails its CRC and the
+// previous record of that id stays current. Live records are never
+// overwritten: when the head reaches the live record of another id, that
+// record is first copied past the head, so unchanged patterns rotate through
+// the array too and wear spreads over the whole chip.
+constexpr uint8_t RECORD_TAG = 0x5A;
+constexpr uint8_t RECORD_SIZE = 32;
+constexpr uint16_t NUM_RECORDS = EEPROM_SIZE / RECORD_SIZE;
+constexpr uint8_t PAYLOAD_OFFSET = 4;
+constexpr uint8_t PAYLOAD_SIZE = 19;
+constexpr uint8_t ID_HIGH_OFFSET = PAYLOAD_OFFSET + PAYLOAD_SIZE;
+static_assert(EEPROM_CAL_OCTAVES + 1 <= PAYLOAD_SIZE, "calibration must fit a record");
+static_assert(CV_B_STEPS_PER_RECORD * 3 / 2 <= PAYLOAD_SIZE, "CV lane half must fit a record");
+static_assert((ENGINE_TRACKS - 1) * 3 <= PAYLOAD_SIZE, "track gates must fit a record");
+static_assert(TIMING_STEPS_PER_RECORD * 2 <= PAYLOAD_SIZE, "step timing half must fit a record");
+// Each chain record holds a generation, the chain length and its share of
+// the (slot, repeats) pairs. A record whose generation or length differs
+// from the first one's is left over from an older chain.
+constexpr uint8_t CHAIN_ENTRIES_PER_RECORD = (PAYLOAD_SIZE - 2) / 2;
+static_assert(EEPROM_CHAIN_LENGTH <= CHAIN_RECORDS * CHAIN_ENTRIES_PER_RECORD, "chain must fit its records");
+constexpr uint8_t CRC_OFFSET = RECORD_SIZE - 2;
+constexpr uint16_t NO_RECORD = 0xFFFF;
+// Free records kept back so compaction always has somewhere to move to.
+constexpr uint16_t RESERVED_RECORDS = 2;
+constexpr uint16_t LEGACY_RECORDS = (V1_SLOTS * LEGACY_PATTERN_SIZE + RECORD_SIZE - 1) / RECORD_SIZE;
+constexpr uint16_t LEGACY_MAGIC_RECORD = LEGACY_MAGIC_ADDR / RECORD_SIZE;
+// Boot scans tried before running without the store.
+constexpr uint8_t SCAN_ATTEMPTS = 3;
 
 bool initialized = false;
+
+// RAM index built at boot: record id <-> record position, plus the append
+// state. The calibration payload is cached by the same scan.
+uint16_t record_of_id[NUM_RECORD_IDS];
+uint16_t id_at[NUM_RECORDS];
+uint16_t live_records = 0;
+uint8_t calibration_payload[PAYLOAD_SIZE];
+uint16_t head = 0;
+uint16_t next_seq = 0;
+uint8_t chain_generation = 0;  // of the last chain read or written
+
+uint16_t record_id(uint8_t slot, uint8_t page, PagePart part) {
+    if (part >= PART_TIMING_LO) {
+        return TIMING_ID_BASE + (uint16_t)((slot * EEPROM_PAGES + page) * TIMING_PARTS + part - PART_TIMING_LO);
+    }
+    if (page == 0 && slot < V1_SLOTS) {
+        switch (part) {
+        case PART_NOTES: return slot;
+        case PART_CV_LO: return V1_CV_B_ID + 2 * slot;
+        case PART_CV_HI: return V1_CV_B_ID + 2 * slot + 1;
+        default: return V1_TRACKS_ID + slot;
+        }
+    }
+    return PAGE_ID_BASE + (uint16_t)((slot * EEPROM_PAGES + page) * PAGE_PARTS + part);
+}
+
+// Point an id at a committed record, keeping both directions of the index.
+void index_record(uint16_t id, uint16_t pos) {
+    uint16_t old = record_of_id[id];
+    if (old != NO_RECORD) {
+        id_at[old] = NO_RECORD;
+    } else {
+        live_records++;
+    }
+    record_of_id[id] = pos;
+    id_at[pos] = id;
+}
+
+uint8_t device_addr(uint16_t addr) {
+    return WIDE_ADDRESS ? EEPROM_BASE_ADDR : (uint8_t)(EEPROM_BASE_ADDR | ((addr >> 8) & 0x07));
+}
+
+// Word address bytes for `addr`; returns how many were written.
+uint8_t put_word_address(uint8_t* buf, uint16_t addr) {
+    if (WIDE_ADDRESS) {
+        buf[0] = addr >> 8;
+        buf[1] = addr & 0xFF;
+        return 2;
+    }
+    buf[0] = addr & 0xFF;
+    return 1;
+}
+
+uint16_t crc16(const uint8_t* data, uint16_t len) {
+    uint16_t crc = 0xFFFF;
+    for (uint16_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+uint16_t record_seq(const uint8_t* rec) {
+    return (uint16_t)rec[2] | ((uint16_t)rec[3] << 8);
+}
+
+uint16_t record_id_of(const uint8_t* rec) {
+    return (uint16_t)rec[1] | ((uint16_t)(rec[ID_HIGH_OFFSET] ^ 0xFF) << 8);
+}
+
+// Sequence numbers wrap; compare them as serial numbers.
+bool seq_newer(uint16_t a, uint16_t b) {
+    return (int16_t)(a - b) > 0;
+}
+
+bool record_valid(const uint8_t* rec) {
+    if (rec[0] != RECORD_TAG || record_id_of(rec) >= NUM_RECORD_IDS) return false;
+    uint16_t stored = (uint16_t)rec[CRC_OFFSET] | ((uint16_t)rec[CRC_OFFSET + 1] << 8);
+    return crc16(rec, CRC_OFFSET) == stored;
+}
+
+// Stamp header, padding and CRC onto a record whose payload is filled in.
+void seal_record(uint8_t* rec, uint16_t id, uint16_t seq) {
+    rec[0] = RECORD_TAG;
+    rec[1] = id & 0xFF;
+    rec[2] = seq & 0xFF;
+    rec[3] = seq >> 8;
+    memset(&rec[ID_HIGH_OFFSET], 0xFF, CRC_OFFSET - ID_HIGH_OFFSET);
+    rec[ID_HIGH_OFFSET] = (uint8_t)~(id >> 8);
+    uint16_t crc = crc16(rec, CRC_OFFSET);
+    rec[CRC_OFFSET] = crc & 0xFF;
+    rec[CRC_OFFSET + 1] = crc >> 8;
+}
+
+// Part payloads. Gate masks are big endian, as in the legacy layout.
+void encode_part(uint8_t* dst, const PatternPage& page, uint8_t page_index, PagePart part) {
+    memset(dst, 0, PAYLOAD_SIZE);
+    switch (part) {
+    case PART_NOTES:
+        memcpy(dst, page.notes, EEPROM_PAGE_STEPS);
+        dst[16] = (uint8_t)(page.gate_mask[0] >> 8);
+        dst[17] = (uint8_t)(page.gate_mask[0] & 0xFF);
+        dst[18] = page_index == 0 ? page.steps[0] : 0;
+        break;
+    case PART_CV_LO:
+    case PART_CV_HI: {
+        // 12-bit codes packed two per three bytes.
+        const uint16_t* src = &page.cv_b[(part - PART_CV_LO) * CV_B_STEPS_PER_RECORD];
+        for (uint8_t i = 0; i < CV_B_STEPS_PER_RECORD; i += 2, dst += 3) {
+            uint16_t a = src[i] & 0x0FFF;
+            uint16_t b = src[i + 1] & 0x0FFF;
+            dst[0] = a & 0xFF;
+            dst[1] = (uint8_t)((a >> 8) | ((b & 0x0F) << 4));
+            dst[2] = (uint8_t)(b >> 4);
+        }
+        break;
+    }
+    case PART_TIMING_LO:
+    case PART_TIMING_HI: {
+        // Two bytes per step: gate length and offset in 7 bits each, the
+        // ratchet count minus one split over the top bits.
+        uint8_t first = (part - PART_TIMING_LO) * TIMING_STEPS_PER_RECORD;
+        for (uint8_t i = first; i < first + TIMING_STEPS_PER_RECORD; i++, dst += 2) {
+            uint8_t extra = page.ratchets[i] ? (uint8_t)((page.ratchets[i] - 1) & 3) : 0;
+            dst[0] = (uint8_t)((page.gate_len[i] & 0x7F) | ((extra & 1) << 7));
+            dst[1] = (uint8_t)((page.offset[i] & 0x7F) | ((extra >> 1) << 7));
+        }
+        break;
+    }
+    default:
+        for (uint8_t t = 1; t < ENGINE_TRACKS; t++, dst += 3) {
+            dst[0] = (uint8_t)(page.gate_mask[t] >> 8);
+            dst[1] = (uint8_t)(page.gate_mask[t] & 0xFF);
+            dst[2] = page_index == 0 ? page.steps[t] : 0;
+        }
+        break;
+    }
+}
+
+void decode_part(const uint8_t* src, PatternPage* page, uint8_t page_index, PagePart part) {
+    switch (part) {
+    case PART_NOTES:
+        memcpy(page->notes, src, EEPROM_PAGE_STEPS);
+        page->gate_mask[0] = ((uint16_t)src[16] << 8) | src[17];
+        if (page_index == 0) page->steps[0] = src[18];
+        break;
+    case PART_CV_LO:
+    case PART_CV_HI: {
+        uint16_t* dst = &page->cv_b[(part - PART_CV_LO) * CV_B_STEPS_PER_RECORD];
+        for (uint8_t i = 0; i < CV_B_STEPS_PER_RECORD; i += 2, src += 3) {
+            dst[i] = (uint16_t)(src[0] | ((src[1] & 0x0F) << 8));
+            dst[i + 1] = (uint16_t)((src[1] >> 4) | (src[2] << 4));
+        }
+        break;
+    }
+    case PART_TIMING_LO:
+    case PART_TIMING_HI: {
+        uint8_t first = (part - PART_TIMING_LO) * TIMING_STEPS_PER_RECORD;
+        for (uint8_t i = first; i < first + TIMING_STEPS_PER_RECORD; i++, src += 2) {
+            uint8_t extra = (uint8_t)((src[0] >> 7) | ((src[1] >> 7) << 1));
+            page->gate_len[i] = src[0] & 0x7F;
+            page->offset[i] = (int8_t)(uint8_t)(src[1] << 1) >> 1;
+            page->ratchets[i] = extra ? (uint8_t)(extra + 1) : 0;
+        }
+        break;
+    }
+    default:
+        for (uint8_t t = 1; t < ENGINE_TRACKS; t++, src += 3) {
+            page->gate_mask[t] = ((uint16_t)src[0] << 8) | src[1];
+            if (page_index == 0) page->steps[t] = src[2];
+        }
+        break;
+    }
+}
+
+// A part still at its default (a zero lane B, silent extra tracks past page
+// 0, plain step timing) needs no record as long as it never had one: reading it back yields
+// the default anyway.
+bool part_needed(const PatternPage& page, uint8_t slot, uint8_t page_index, PagePart part) {
+    if (record_of_id[record_id(slot, page_index, part)] != NO_RECORD) return true;
+    switch (part) {
+    case PART_NOTES:
+        return true;
+    case PART_CV_LO:
+    case PART_CV_HI: {
+        const uint16_t* cv = &page.cv_b[(part - PART_CV_LO) * CV_B_STEPS_PER_RECORD];
+        for (uint8_t i = 0; i < CV_B_STEPS_PER_RECORD; i++) {
+            if (cv[i] != 0) return true;
+        }
+        return false;
+    }
+    case PART_TIMING_LO:
+    case PART_TIMING_HI: {
+        uint8_t first = (part - PART_TIMING_LO) * TIMING_STEPS_PER_RECORD;
+        for (uint8_t i = first; i < first + TIMING_STEPS_PER_RECORD; i++) {
+            if (page.gate_len[i] != 0 || page.ratchets[i] > 1 || page.offset[i] != 0) return true;
+        }
+        return false;
+    }
+    default:
+        if (page_index == 0) return true;
+        for (uint8_t t = 1; t < ENGINE_TRACKS; t++) {
+            if (page.gate_mask[t] != 0) return true;
+        }
+        return false;
+    }
+}
+
+// First position at or after `pos` that holds no live record.
+uint16_t next_free(uint16_t pos) {
+    for (uint16_t i = 0; i < NUM_RECORDS; i++) {
+        uint16_t p = (pos + i) % NUM_RECORDS;
+        if (id_at[p] == NO_RECORD) return p;
+    }
+    return pos;  // unreachable: RESERVED_RECORDS are always free
+}
+
+// Background writer. A job appends up to six records (the parts of one
+// page), each preceded by the relocation of the live record at the head
+// when compaction is needed. Every record commits on its own, so a torn job
+// leaves each id at either its old or its new value. job_step() performs at
+// most one short I2C operation per call: the relocation read, a page write,
+// or one ACK poll (the chip NACKs its address until the write cycle
+// finishes; an address-only write just sets the read pointer).
+enum class JobState : uint8_t { IDLE, READ_RELOCATE, WRITE_PAGE, WAIT_CYCLE };
+
+struct JobRecord {
+    uint16_t id;
+    uint16_t pos;
+    uint16_t seq;
+    uint8_t data[RECORD_SIZE];
+};
+
+constexpr uint8_t MAX_JOB_APPENDS = NUM_PARTS;
+
+JobState job_state = JobState::IDLE;
+uint16_t job_append_ids[MAX_JOB_APPENDS];
+uint8_t job_append_payloads[MAX_JOB_APPENDS][PAYLOAD_SIZE];
+uint8_t job_append_count = 0;
+uint8_t job_append_index = 0;
+JobRecord job_records[2];
+uint8_t job_count = 0;
+uint8_t job_index = 0;
+uint16_t job_relocate_from = 0;
+uint8_t job_pos = 0;  // byte offset inside the current record
+uint8_t job_chunk = 0;
+uint16_t job_head_after = 0;
+uint64_t job_cycle_start_us = 0;
+// Outcome of a background job finished by a blocking call, still to be
+// reported by eeprom_service().
+EepromJobStatus drained_status = EEPROM_JOB_IDLE;
+
+// Set up the writes for the next append of the job.
+void begin_append(uint16_t id, const uint8_t* payload) {
+    // Never overwrite the current record of the id being saved.
+    uint16_t pos = head;
+    if (id_at[pos] == id) pos = next_free((pos + 1) % NUM_RECORDS);
+
+    job_count = 0;
+    job_index = 0;
+    job_pos = 0;
+    uint16_t live = id_at[pos];
+    if (live != NO_RECORD) {
+        // Compaction: copy the other id's record past the head first. The
+        // copy gets the higher sequence number so the head lands after it.
+        JobRecord& moved = job_records[job_count++];
+        moved.id = live;
+        moved.pos = next_free((pos + 1) % NUM_RECORDS);
+        moved.seq = (uint16_t)(next_seq + 1);
+        job_relocate_from = pos;
+        job_head_after = (moved.pos + 1) % NUM_RECORDS;
+        job_state = JobState::READ_RELOCATE;
+    } else {
+        job_head_after = (pos + 1) % NUM_RECORDS;
+        job_state = JobState::WRITE_PAGE;
+    }
+
+    JobRecord& rec = job_records[job_count++];
+    rec.id = id;
+    rec.pos = pos;
+    rec.seq = next_seq;
+    memcpy(&rec.data[PAYLOAD_OFFSET], payload, PAYLOAD_SIZE);
+    seal_record(rec.data, id, rec.seq);
+    next_seq = (uint16_t)(next_seq + job_count);
+}
+
+bool job_start(uint8_t count, const uint16_t* ids, const uint8_t (*payloads)[PAYLOAD_SIZE]) {
+    if (job_state != JobState::IDLE || count == 0) return false;
+
+    job_append_count = count;
+    job_append_index = 0;
+    memcpy(job_append_ids, ids, count * sizeof(ids[0]));
+    memcpy(job_append_payloads, payloads, count * PAYLOAD_SIZE);
+    begin_append(job_append_ids[0], job_append_payloads[0]);
+    return true;
+}
+
+EepromJobStatus job_fail() {
+    job_state = JobState::IDLE;
+    return EEPROM_JOB_FAILED;
+}
+
+EepromJobStatus job_step() {
+    if (job_state == JobState::IDLE) return EEPROM_JOB_IDLE;
+
+    JobRecord& rec = job_records[job_index];
+    uint8_t buf[PAGE_SIZE + 2];
+    if (job_state == JobState::READ_RELOCATE) {
+        uint16_t from = job_relocate_from * RECORD_SIZE;
+        uint8_t n = put_word_address(buf, from);
+        if (i2c_write_blocking(i2c1, device_addr(from), buf, n, true) < 0) return job_fail();
+        if (i2c_read_blocking(i2c1, device_addr(from), rec.data, RECORD_SIZE, false) < 0) return job_fail();
+        if (!record_valid(rec.data) || record_id_of(rec.data) != rec.id) return job_fail();
+        seal_record(rec.data, rec.id, rec.seq);
+        job_state = JobState::WRITE_PAGE;
+        return EEPROM_JOB_BUSY;
+    }
+
+    uint16_t addr = rec.pos * RECORD_SIZE + job_pos;
+    uint8_t n = put_word_address(buf, addr);
+    if (job_state == JobState::WRITE_PAGE) {
+        job_chunk = PAGE_SIZE - (addr % PAGE_SIZE);
+        if (job_chunk > RECORD_SIZE - job_pos) job_chunk = RECORD_SIZE - job_pos;
+
+        memcpy(&buf[n], &rec.data[job_pos], job_chunk);
+        if (i2c_write_blocking(i2c1, device_addr(addr), buf, job_chunk + n, false) < 0) return job_fail();
+        job_state = JobState::WAIT_CYCLE;
+        job_cycle_start_us = time_us_64();
+        return EEPROM_JOB_BUSY;
+    }
+
+    if (i2c_write_blocking(i2c1, device_addr(addr), buf, n, false) < 0) {
+        if ((time_us_64() - job_cycle_start_us) >= WRITE_CYCLE_TIMEOUT_US) return job_fail();
+        return EEPROM_JOB_BUSY;
+    }
+
+    job_pos += job_chunk;
+    if (job_pos < RECORD_SIZE) {
+        job_state = JobState::WRITE_PAGE;
+        return EEPROM_JOB_BUSY;
+    }
+
+    // Record committed: it is now the current one for its id.
+    index_record(rec.id, rec.pos);
+    job_pos = 0;
+    if (++job_index < job_count) {
+        job_state = JobState::WRITE_PAGE;
+        return EEPROM_JOB_BUSY;
+    }
+    head = job_head_after;
+    if (++job_append_index < job_append_count) {
+        begin_append(job_append_ids[job_append_index], job_append_payloads[job_append_index]);
+        return EEPROM_JOB_BUSY;
+    }
+    job_state = JobState::IDLE;
+    return EEPROM_JOB_DONE;
+}
+
+// Run a background job to completion before a blocking access.
+void drain_job() {
+    while (job_state != JobState::IDLE) {
+        EepromJobStatus status = job_step();
+        if (status == EEPROM_JOB_DONE || status == EEPROM_JOB_FAILED) drained_status = status;
+    }
+}
+
+// Finish any background job, then append these records to completion.
+bool append_records(uint8_t count, const uint16_t* ids, const uint8_t (*payloads)[PAYLOAD_SIZE]) {
+    drain_job();
+    if (!job_start(count, ids, payloads)) return false;
+    EepromJobStatus status;
+    do {
+        status = job_step();
+    } while (status == EEPROM_JOB_BUSY);
+    return status == EEPROM_JOB_DONE;
+}
+
+bool append_record(uint16_t id, const uint8_t* payload) {
+    uint8_t payloads[1][PAYLOAD_SIZE];
+    memcpy(payloads[0], payload, PAYLOAD_SIZE);
+    return append_records(1, &id, payloads);
+}
+
+// Ids and payloads of the parts of a page that need a record.
+uint8_t encode_page(uint8_t slot, uint8_t page_index, const PatternPage& page, uint16_t* ids,
+                    uint8_t (*payloads)[PAYLOAD_SIZE]) {
+    uint8_t count = 0;
+    for (uint8_t p = 0; p < NUM_PARTS; p++) {
+        PagePart part = (PagePart)p;
+        if (!part_needed(page, slot, page_index, part)) continue;
+        ids[count] = record_id(slot, page_index, part);
+        encode_part(payloads[count], page, page_index, part);
+        count++;
+    }
+    return count;
+}
+
+// Ids and payloads of the chain records. The first is always written; the
+// others only while the chain reaches them, since a reader ignores them
+// otherwise.
+uint8_t encode_chain(const uint8_t* slots, const uint8_t* repeats, uint8_t length, uint8_t generation,
+                     uint16_t* ids, uint8_t (*payloads)[PAYLOAD_SIZE]) {
+    uint8_t count = 0;
+    for (uint8_t r = 0; r < CHAIN_RECORDS; r++) {
+        uint8_t first = r * CHAIN_ENTRIES_PER_RECORD;
+        if (r > 0 && length <= first) break;
+        uint8_t* payload = payloads[count];
+        memset(payload, 0xFF, PAYLOAD_SIZE);
+        payload[0] = generation;
+        payload[1] = length;
+        for (uint8_t i = first; i < length && i < first + CHAIN_ENTRIES_PER_RECORD; i++) {
+            payload[2 + 2 * (i - first)] = slots[i];
+            payload[3 + 2 * (i - first)] = repeats[i];
+        }
+        ids[count++] = CHAIN_ID_BASE + r;
+    }
+    return count;
+}
+
+// A record for the calibration is kept free until it has one, so a full
+// pattern library never locks out tuning.
+bool room_for(uint32_t added, bool calibration) {
+    uint32_t reserved = RESERVED_RECORDS;
+    if (!calibration && record_of_id[CALIBRATION_ID] == NO_RECORD) reserved++;
+    return added == 0 || live_records + added + reserved <= NUM_RECORDS;
+}
+
+uint8_t count_new(uint8_t count, const uint16_t* ids) {
+    uint8_t added = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        if (record_of_id[ids[i]] == NO_RECORD) added++;
+    }
+    return added;
+}
+
+bool fits(uint8_t count, const uint16_t* ids) {
+    bool calibration = false;
+    for (uint8_t i = 0; i < count; i++) calibration |= ids[i] == CALIBRATION_ID;
+    return room_for(count_new(count, ids), calibration);
+}
+
+// Sequential read, one address-set + read pair per 256-byte block (on the
+// 24C16 the block-select bits live in the device address).
+bool read_bytes(uint16_t addr, uint8_t* dst, uint16_t len) {
+    drain_job();
+    while (len > 0) {
+        uint16_t chunk = 256 - (addr & 0xFF);
+        if (chunk > len) chunk = len;
+
+        uint8_t word[2];
+        uint8_t n = put_word_address(word, addr);
+        if (i2c_write_blocking(i2c1, device_addr(addr), word, n, true) < 0) return false;
+        if (i2c_read_blocking(i2c1, device_addr(addr), dst, chunk, false) < 0) return false;
+
+        addr += chunk;
+        dst += chunk;
+        len -= chunk;
+    }
+    return true;
+}
+
+// Write one byte and wait out its write cycle.
+bool write_byte(uint16_t addr, uint8_t value) {
+    drain_job();
+    uint8_t buf[3];
+    uint8_t n = put_word_address(buf, addr);
+    buf[n] = value;
+    if (i2c_write_blocking(i2c1, device_addr(addr), buf, n + 1, false) < 0) return false;
+    uint64_t start_us = time_us_64();
+    while (i2c_write_blocking(i2c1, device_addr(addr), buf, n, false) < 0) {
+        if ((time_us_64() - start_us) >= WRITE_CYCLE_TIMEOUT_US) return false;
+    }
+    return true;
+}
+
+// Import the legacy fixed-slot layout. Records are appended after the legacy
+// pattern bytes, one per slot that has none yet, and the marker is cleared
+// only once all of them are written, so an interrupted import resumes on the
+// next boot with the slots still missing.
+void import_legacy() {
+    uint8_t magic = 0;
+    if (!read_bytes(LEGACY_MAGIC_ADDR, &magic, 1) || magic != LEGACY_MAGIC_BYTE) return;
+
+    uint8_t buf[V1_SLOTS * LEGACY_PATTERN_SIZE];
+    if (!read_bytes(0, buf, sizeof(buf))) return;
+
+    if (head < LEGACY_RECORDS) head = LEGACY_RECORDS;
+    for (uint8_t slot = 0; slot < V1_SLOTS; slot++) {
+        uint16_t id = record_id(slot, 0, PART_NOTES);
+        if (record_of_id[id] != NO_RECORD) continue;
+        // The legacy pattern bytes are exactly a page 0 notes part.
+        if (!append_record(id, &buf[slot * LEGACY_PATTERN_SIZE])) return;
+    }
+    write_byte(LEGACY_MAGIC_ADDR, 0x00);
+}
+
+void reset_index() {
+    memset(record_of_id, 0xFF, sizeof(record_of_id));
+    memset(id_at, 0xFF, sizeof(id_at));
+    live_records = 0;
+    head = 0;
+    next_seq = 0;
+}
+
+// Build the RAM index from one pass over the chip. Returns false if a read
+// failed, leaving the index incomplete.
+bool scan_records(bool* legacy_overwritten) {
+    reset_index();
+    *legacy_overwritten = false;
+
+    // One sequential read per 256-byte block.
+    static uint16_t id_seq[NUM_RECORD_IDS];
+    bool any = false;
+    uint16_t newest = 0;
+    for (uint32_t block = 0; block < EEPROM_SIZE; block += 256) {
+        uint8_t buf[256];
+        if (!read_bytes((uint16_t)block, buf, sizeof(buf))) return false;
+
+        for (uint16_t off = 0; off < sizeof(buf); off += RECORD_SIZE) {
+            const uint8_t* rec = &buf[off];
+            if (!record_valid(rec)) continue;
+
+            uint16_t id = record_id_of(rec);
+            uint16_t seq = record_seq(rec);
+            uint16_t pos = (uint16_t)((block + off) / RECORD_SIZE);
+            if (pos < LEGACY_RECORDS || pos == LEGACY_MAGIC_RECORD) *legacy_overwritten = true;
+            if (record_of_id[id] == NO_RECORD || seq_newer(seq, id_seq[id])) {
+                index_record(id, pos);
+                id_seq[id] = seq;
+                if (id == CALIBRATION_ID) memcpy(calibration_payload, &rec[PAYLOAD_OFFSET], PAYLOAD_SIZE);
+            }
+            if (!any || seq_newer(seq, newest)) {
+                newest = seq;
+                head = (pos + 1) % NUM_RECORDS;
+                any = true;
+            }
+        }
+    }
+
+    if (any) next_seq = (uint16_t)(newest + 1);
+    return true;
+}
 }
 
 void eeprom_init() {
@@ -23,13 +647,13 @@ void eeprom_init() {
     gpio_set_function(SCL_PIN, GPIO_FUNC_I2C);
     gpio_pull_up(SDA_PIN);
     gpio_pull_up(SCL_PIN);
-    
+
     sleep_ms(50);
-    
+
     uint8_t probe = 0x00;
     int result = i2c_write_blocking(i2c1, EEPROM_BASE_ADDR, &probe, 1, false);
     initialized = (result >= 0);
-    
+
     if (initialized) {
         sleep_ms(10);
     }
@@ -39,94 +663,162 @@ bool eeprom_is_initialized() {
     return initialized;
 }
 
-void eeprom_write_pattern(uint8_t slot, const uint8_t* notes, uint16_t gate_mask, uint8_t steps) {
-    if (!initialized || slot >= NUM_PATTERNS) return;
-    
-    uint16_t addr = slot * PATTERN_STORAGE_SIZE;
-    
-    for (int i = 0; i < 16; i++) {
-        uint16_t byte_addr = addr + i;
-        uint8_t i2c_addr = EEPROM_BASE_ADDR | ((byte_addr >> 8) & 0x07);
-        uint8_t local_addr = byte_addr & 0xFF;
-        
-        uint8_t buf[2] = {local_addr, notes[i]};
-        i2c_write_blocking(i2c1, i2c_addr, buf, 2, false);
-        sleep_ms(5);
-    }
-    
-    uint16_t gate_addr = addr + 16;
-    uint8_t gate_i2c_addr = EEPROM_BASE_ADDR | ((gate_addr >> 8) & 0x07);
-    uint8_t gate_local_addr = gate_addr & 0xFF;
-    uint8_t buf1[2] = {gate_local_addr, (uint8_t)((gate_mask >> 8) & 0xFF)};
-    i2c_write_blocking(i2c1, gate_i2c_addr, buf1, 2, false);
-    sleep_ms(5);
-    
-    gate_addr++;
-    gate_i2c_addr = EEPROM_BASE_ADDR | ((gate_addr >> 8) & 0x07);
-    gate_local_addr = gate_addr & 0xFF;
-    uint8_t buf2[2] = {gate_local_addr, (uint8_t)(gate_mask & 0xFF)};
-    i2c_write_blocking(i2c1, gate_i2c_addr, buf2, 2, false);
-    sleep_ms(5);
-    
-    uint16_t steps_addr = addr + 18;
-    uint8_t steps_i2c_addr = EEPROM_BASE_ADDR | ((steps_addr >> 8) & 0x07);
-    uint8_t steps_local_addr = steps_addr & 0xFF;
-    uint8_t buf3[2] = {steps_local_addr, steps};
-    i2c_write_blocking(i2c1, steps_i2c_addr, buf3, 2, false);
-    sleep_ms(5);
-}
-
-void eeprom_read_pattern(uint8_t slot, uint8_t* notes, uint16_t* gate_mask, uint8_t* steps) {
-    if (!initialized || slot >= NUM_PATTERNS) return;
-    
-    uint16_t addr = slot * PATTERN_STORAGE_SIZE;
-    uint8_t i2c_addr = EEPROM_BASE_ADDR | ((addr >> 8) & 0x07);
-    uint8_t local_addr = addr & 0xFF;
-    
-    i2c_write_blocking(i2c1, i2c_addr, &local_addr, 1, true);
-    i2c_read_blocking(i2c1, i2c_addr, notes, 16, false);
-    
-    uint16_t gate_addr = addr + 16;
-    uint8_t gate_i2c_addr = EEPROM_BASE_ADDR | ((gate_addr >> 8) & 0x07);
-    uint8_t gate_local_addr = gate_addr & 0xFF;
-    
-    i2c_write_blocking(i2c1, gate_i2c_addr, &gate_local_addr, 1, true);
-    
-    uint8_t gate_data[2];
-    i2c_read_blocking(i2c1, gate_i2c_addr, gate_data, 2, false);
-    *gate_mask = ((uint16_t)gate_data[0] << 8) | gate_data[1];
-    
-    uint16_t steps_addr = addr + 18;
-    uint8_t steps_i2c_addr = EEPROM_BASE_ADDR | ((steps_addr >> 8) & 0x07);
-    uint8_t steps_local_addr = steps_addr & 0xFF;
-    
-    i2c_write_blocking(i2c1, steps_i2c_addr, &steps_local_addr, 1, true);
-    i2c_read_blocking(i2c1, steps_i2c_addr, steps, 1, false);
-}
-
-bool eeprom_has_valid_data() {
-    if (!initialized) return false;
-    
-    uint8_t i2c_addr = EEPROM_BASE_ADDR | ((MAGIC_ADDR >> 8) & 0x07);
-    uint8_t local_addr = MAGIC_ADDR & 0xFF;
-    
-    i2c_write_blocking(i2c1, i2c_addr, &local_addr, 1, true);
-    
-    uint8_t magic = 0;
-    i2c_read_blocking(i2c1, i2c_addr, &magic, 1, false);
-    
-    return (magic == MAGIC_BYTE);
+void eeprom_load_index() {
+    bool legacy_overwritten = false;
+    for (uint8_t attempt = 0; initialized && attempt < SCAN_ATTEMPTS; attempt++) {
+        if (scan_records(&legacy_overwritten)) {
+            // A record over the legacy bytes or the marker means the log has
+            // wrapped past them: the marker byte is then record data.
+            if (!legacy_overwritten) import_legacy();
+            return;
+        }
+    }
+    // Appending from a partial index could overwrite records it never saw,
+    // with sequence numbers older than theirs: run without the store.
+    reset_index();
+    initialized = false;
+}
+
+bool eeprom_read_page(uint8_t slot, uint8_t page_index, PatternPage* page) {
+    if (!initialized || slot >= EEPROM_PATTERN_SLOTS || page_index >= EEPROM_PAGES) return false;
+
+    bool found = false;
+    for (uint8_t p = 0; p < NUM_PARTS; p++) {
+        PagePart part = (PagePart)p;
+        uint16_t pos = record_of_id[record_id(slot, page_index, part)];
+        if (pos == NO_RECORD) continue;
+        uint8_t rec[RECORD_SIZE];
+        if (!read_bytes(pos * RECORD_SIZE, rec, RECORD_SIZE)) return found;
+        if (!record_valid(rec)) continue;
+        decode_part(&rec[PAYLOAD_OFFSET], page, page_index, part);
+        found = true;
+    }
+    return found;
+}
+
+uint32_t eeprom_page_new_records(uint8_t slot, uint8_t page_index, const PatternPage& page) {
+    if (slot >= EEPROM_PATTERN_SLOTS || page_index >= EEPROM_PAGES) return 0;
+
+    uint16_t ids[MAX_JOB_APPENDS];
+    uint8_t payloads[MAX_JOB_APPENDS][PAYLOAD_SIZE];
+    uint8_t count = encode_page(slot, page_index, page, ids, payloads);
+    return count_new(count, ids);
+}
+
+bool eeprom_has_room(uint32_t new_records) {
+    return initialized && room_for(new_records, false);
+}
+
+bool eeprom_write_page(uint8_t slot, uint8_t page_index, const PatternPage& page) {
+    if (!initialized || slot >= EEPROM_PATTERN_SLOTS || page_index >= EEPROM_PAGES) return false;
+
+    uint16_t ids[MAX_JOB_APPENDS];
+    uint8_t payloads[MAX_JOB_APPENDS][PAYLOAD_SIZE];
+    uint8_t count = encode_page(slot, page_index, page, ids, payloads);
+    return fits(count, ids) && append_records(count, ids, payloads);
+}
+
+bool eeprom_write_page_async(uint8_t slot, uint8_t page_index, const PatternPage& page) {
+    if (!initialized || slot >= EEPROM_PATTERN_SLOTS || page_index >= EEPROM_PAGES) return false;
+    if (job_state != JobState::IDLE) return false;
+
+    uint16_t ids[MAX_JOB_APPENDS];
+    uint8_t payloads[MAX_JOB_APPENDS][PAYLOAD_SIZE];
+    uint8_t count = encode_page(slot, page_index, page, ids, payloads);
+    return fits(count, ids) && job_start(count, ids, payloads);
+}
+
+EepromJobStatus eeprom_service() {
+    if (drained_status != EEPROM_JOB_IDLE) {
+        EepromJobStatus status = drained_status;
+        drained_status = EEPROM_JOB_IDLE;
+        return status;
+    }
+    return job_step();
+}
+
+uint32_t eeprom_records_live() {
+    return live_records;
+}
+
+uint32_t eeprom_records_total() {
+    return NUM_RECORDS;
 }
 
-void eeprom_mark_valid() {
+bool eeprom_read_calibration(int8_t* octave_offsets, int8_t* fine_cents) {
+    if (!initialized || record_of_id[CALIBRATION_ID] == NO_RECORD) return false;
+
+    memcpy(octave_offsets, calibration_payload, EEPROM_CAL_OCTAVES);
+    *fine_cents = (int8_t)calibration_payload[EEPROM_CAL_OCTAVES];
+    return true;
+}
+
+void eeprom_write_calibration(const int8_t* octave_offsets, int8_t fine_cents) {
     if (!initialized) return;
-    
-    uint8_t i2c_addr = EEPROM_BASE_ADDR | ((MAGIC_ADDR >> 8) & 0x07);
-    uint8_t local_addr = MAGIC_ADDR & 0xFF;
-    
-    uint8_t buf[2];
-    buf[0] = local_addr;
-    buf[1] = MAGIC_BYTE;
-    i2c_write_blocking(i2c1, i2c_addr, buf, 2, false);
-    sleep_ms(10);
+
+    uint8_t payload[PAYLOAD_SIZE] = {0};
+    memcpy(payload, octave_offsets, EEPROM_CAL_OCTAVES);
+    payload[EEPROM_CAL_OCTAVES] = (uint8_t)fine_cents;
+    uint16_t id = CALIBRATION_ID;
+    if (fits(1, &id) && append_record(CALIBRATION_ID, payload)) {
+        memcpy(calibration_payload, payload, PAYLOAD_SIZE);
+    }
+}
+
+bool eeprom_read_chain(uint8_t* slots, uint8_t* repeats, uint8_t* length) {
+    if (!initialized || record_of_id[CHAIN_ID_BASE] == NO_RECORD) return false;
+
+    uint8_t generation = 0;
+    uint8_t stored_length = 0;
+    *length = 0;
+    for (uint8_t r = 0; r < CHAIN_RECORDS; r++) {
+        uint8_t first = r * CHAIN_ENTRIES_PER_RECORD;
+        if (r > 0 && stored_length <= first) break;
+        uint16_t pos = record_of_id[CHAIN_ID_BASE + r];
+        uint8_t rec[RECORD_SIZE];
+        bool valid = pos != NO_RECORD && read_bytes(pos * RECORD_SIZE, rec, RECORD_SIZE) && record_valid(rec);
+        if (r == 0) {
+            if (!valid) return false;
+            generation = rec[PAYLOAD_OFFSET];
+            stored_length = rec[PAYLOAD_OFFSET + 1];
+            chain_generation = generation;
+        } else if (!valid || rec[PAYLOAD_OFFSET] != generation || rec[PAYLOAD_OFFSET + 1] != stored_length) {
+            // A save torn between the records: keep the entries that made it.
+            break;
+        }
+
+        const uint8_t* pairs = &rec[PAYLOAD_OFFSET + 2];
+        for (uint8_t i = first; i < stored_length && i < first + CHAIN_ENTRIES_PER_RECORD; i++) {
+            if (i >= EEPROM_CHAIN_LENGTH) return true;
+            uint8_t slot = pairs[2 * (i - first)];
+            uint8_t count = pairs[2 * (i - first) + 1];
+            if (slot >= EEPROM_PATTERN_SLOTS) return true;
+            slots[i] = slot;
+            repeats[i] = count ? count : 1;
+            *length = i + 1;
+        }
+    }
+    return true;
+}
+
+uint32_t eeprom_chain_new_records(uint8_t length) {
+    uint8_t slots[EEPROM_CHAIN_LENGTH] = {0};
+    uint8_t repeats[EEPROM_CHAIN_LENGTH] = {0};
+    uint16_t ids[CHAIN_RECORDS];
+    uint8_t payloads[CHAIN_RECORDS][PAYLOAD_SIZE];
+    uint8_t count = encode_chain(slots, repeats, length, 0, ids, payloads);
+    return count_new(count, ids);
+}
+
+bool eeprom_write_chain_async(const uint8_t* slots, const uint8_t* repeats, uint8_t length) {
+    if (!initialized || length > EEPROM_CHAIN_LENGTH) return false;
+    if (job_state != JobState::IDLE) return false;
+
+    uint16_t ids[CHAIN_RECORDS];
+    uint8_t payloads[CHAIN_RECORDS][PAYLOAD_SIZE];
+    uint8_t generation = (uint8_t)(chain_generation + 1);
+    uint8_t count = encode_chain(slots, repeats, length, generation, ids, payloads);
+    if (!fits(count, ids) || !job_start(count, ids, payloads)) return false;
+    chain_generation = generation;
+    return true;
 }
@@ -1,15 +1,90 @@
 #pragma once
 
+#include "engine.h"
 #include <cstdint>
 
+enum EepromJobStatus { EEPROM_JOB_IDLE, EEPROM_JOB_BUSY, EEPROM_JOB_DONE, EEPROM_JOB_FAILED };
+
+// Patterns are stored as an append-only log of CRC-protected records spread
+// over the whole chip; the newest valid record of each id is current. Only
+// what was saved has records, so the library can be larger than the chip
+// holds at once: a page that was never saved reads as absent.
+//
+// The chip size comes from the build (SEQ_EEPROM_SIZE, bytes): 2048 for the
+// 24C16 (8-bit word address, block select in the device address), up to
+// 65536 for the 24C32..24C512 family (16-bit word address).
+
 void eeprom_init();
 
-void eeprom_write_pattern(uint8_t slot, const uint8_t* notes, uint16_t gate_mask, uint8_t steps);
+constexpr uint8_t EEPROM_PATTERN_SLOTS = 64;
+constexpr uint8_t EEPROM_PAGE_STEPS = 16;
+constexpr uint8_t EEPROM_PAGES = ENGINE_STEPS / EEPROM_PAGE_STEPS;
 
-void eeprom_read_pattern(uint8_t slot, uint8_t* notes, uint16_t* gate_mask, uint8_t* steps);
+// The unit of storage: 16 steps of one slot. Track 0 in full (notes, lane B,
+// gates and step timing), the gates of the other tracks, and on page 0 the
+// track lengths. The other tracks' notes and lane B have no output and are
+// not stored, nor is their step timing.
+struct PatternPage {
+    uint8_t notes[EEPROM_PAGE_STEPS];
+    uint16_t cv_b[EEPROM_PAGE_STEPS];
+    uint8_t gate_len[EEPROM_PAGE_STEPS];
+    uint8_t ratchets[EEPROM_PAGE_STEPS];
+    int8_t offset[EEPROM_PAGE_STEPS];
+    uint16_t gate_mask[ENGINE_TRACKS];
+    uint8_t steps[ENGINE_TRACKS];  // page 0 only
+};
 
-bool eeprom_is_initialized();
+// Scan the record log and build the RAM index (record id -> position).
+// Imports the old fixed-slot layout while its marker is set. If the scan
+// keeps failing, the store is left uninitialized rather than half-indexed.
+void eeprom_load_index();
+
+// Read the stored parts of a page into `page`. Parts that were never saved
+// are left untouched, so prefill it with defaults. Returns false if the
+// page has no record at all.
+bool eeprom_read_page(uint8_t slot, uint8_t page_index, PatternPage* page);
+
+// Records that saving `page` would add: its parts that have no record yet.
+// Rewriting parts that are stored already adds none.
+uint32_t eeprom_page_new_records(uint8_t slot, uint8_t page_index, const PatternPage& page);
+
+// True if `new_records` more records leave enough free ones to keep
+// compacting. Pages that are all still to be written must be checked
+// together: each may fit on its own while the set does not.
+bool eeprom_has_room(uint32_t new_records);
 
-bool eeprom_has_valid_data();
+// Append the records of a page and wait for them to be committed. Returns
+// false if the page does not fit or the write failed.
+bool eeprom_write_page(uint8_t slot, uint8_t page_index, const PatternPage& page);
 
-void eeprom_mark_valid();
+// Background writes: start a job (returns false while another one is in
+// flight or if the page does not fit), then call eeprom_service() from the
+// main loop. Each call performs at most one short I2C operation (a record
+// read, a page write or an ACK poll) and reports DONE/FAILED once when the
+// job ends.
+bool eeprom_write_page_async(uint8_t slot, uint8_t page_index, const PatternPage& page);
+EepromJobStatus eeprom_service();
+
+// Store occupancy: records holding a current value, out of the total.
+uint32_t eeprom_records_live();
+uint32_t eeprom_records_total();
+
+// Pitch calibration record: a DAC-code offset per MIDI octave (0..10) and a
+// global fine tune in cents. eeprom_read_calibration() returns the copy
+// cached by eeprom_load_index(), or false if none was ever saved.
+constexpr uint8_t EEPROM_CAL_OCTAVES = 11;
+bool eeprom_read_calibration(int8_t* octave_offsets, int8_t* fine_cents);
+void eeprom_write_calibration(const int8_t* octave_offsets, int8_t fine_cents);
+
+// Song chain: up to EEPROM_CHAIN_LENGTH (slot, repeats) entries over two
+// records, both stamped with a generation and the length. A save torn
+// between them reads back cut to the entries of the first record.
+// eeprom_read_chain() returns false if none was ever saved.
+// eeprom_write_chain_async() starts a background job like a page write;
+// eeprom_chain_new_records() is the chain's share of eeprom_has_room().
+constexpr uint8_t EEPROM_CHAIN_LENGTH = 16;
+bool eeprom_read_chain(uint8_t* slots, uint8_t* repeats, uint8_t* length);
+uint32_t eeprom_chain_new_records(uint8_t length);
+bool eeprom_write_chain_async(const uint8_t* slots, const uint8_t* repeats, uint8_t length);
+
+bool eeprom_is_initialized();
@@ -0,0 +1,279 @@
+#include "engine.h"
+
+#include "pico/stdlib.h"
+#include "spsc_ring.h"
+#include <atomic>
+#include <cstring>
+
+namespace {
+SpscRing<EngineCommand, 32> command_ring;
+SpscRing<EngineEvent, 32> event_ring;
+std::atomic<uint32_t> events_dropped{0};
+
+// Consumer-side accounting, core0 only.
+uint32_t ticks_consumed = 0;
+uint32_t max_consume_latency_us = 0;
+
+// Pattern buffer pool. A buffer is free when core0 holds no reference and
+// the engine has dropped every reference it was posted with. Each counter
+// has a single writer (posted: core0, dropped: core1), so no atomic
+// read-modify-write is needed.
+constexpr uint8_t PATTERN_POOL = 8;
+EnginePattern pattern_pool[PATTERN_POOL];
+bool held_by_core0[PATTERN_POOL] = {};
+std::atomic<uint32_t> times_posted[PATTERN_POOL];
+std::atomic<uint32_t> times_dropped[PATTERN_POOL];
+
+int pool_index(const EnginePattern *pattern) {
+  for (uint8_t i = 0; i < PATTERN_POOL; i++) {
+    if (pattern == &pattern_pool[i])
+      return i;
+  }
+  return -1;
+}
+
+// core1: done with one reference to `pattern`.
+void drop(const EnginePattern *pattern) {
+  int i = pool_index(pattern);
+  if (i >= 0)
+    times_dropped[i].store(times_dropped[i].load(std::memory_order_relaxed) + 1,
+                           std::memory_order_release);
+}
+
+// Engine state, owned by core1. core0 loads a pattern before launching it.
+// Every pattern is referenced by pointer: `live` plays, `pending` is an
+// edited version waiting for the next step boundary, and `back` is the next
+// pattern, prefetched so the switch at the loop boundary is a pointer swap.
+const EnginePattern empty_pattern = {};
+const EnginePattern *live = &empty_pattern;
+const EnginePattern *pending = nullptr;
+const EnginePattern *back = nullptr;
+uint8_t back_loops = 1;
+uint8_t loops_left = 1;  // loops of the live pattern before `back` takes over
+bool rewound = true;     // the next wrap starts the pattern, it ends no loop
+bool playing = false;
+uint8_t position[ENGINE_TRACKS] = {0};
+bool switch_unreported = false;
+
+// Step boundary: an edited version becomes live.
+void publish_pending() {
+  if (!pending)
+    return;
+  drop(live);
+  live = pending;
+  pending = nullptr;
+}
+
+uint32_t track_steps(uint8_t track) {
+  uint8_t steps = live->steps[track];
+  return (steps >= 1 && steps <= ENGINE_STEPS) ? steps : ENGINE_STEPS;
+}
+
+// Timing fields as stored, with defaults applied and clamped to range.
+uint8_t gate_length(uint8_t percent) {
+  if (percent == 0)
+    return ENGINE_GATE_DEFAULT;
+  return percent < ENGINE_GATE_MAX ? percent : ENGINE_GATE_MAX;
+}
+
+uint8_t ratchet_count(uint8_t count) {
+  if (count == 0)
+    return 1;
+  return count < ENGINE_RATCHETS_MAX ? count : ENGINE_RATCHETS_MAX;
+}
+
+int8_t step_offset(int8_t percent) {
+  if (percent < -ENGINE_OFFSET_MAX)
+    return -ENGINE_OFFSET_MAX;
+  return percent < ENGINE_OFFSET_MAX ? percent : ENGINE_OFFSET_MAX;
+}
+
+void rewind() {
+  for (uint8_t t = 0; t < ENGINE_TRACKS; t++)
+    position[t] = (uint8_t)(track_steps(t) - 1);
+  rewound = true;
+}
+
+// Move every play head to its next step. Track 0 is the master: when it
+// wraps for the last of the live pattern's loops, a queued pattern is
+// swapped in and all tracks restart on it together. Returns true if that
+// happened.
+bool advance() {
+  bool wrapped = false;
+  for (uint8_t t = 0; t < ENGINE_TRACKS; t++) {
+    uint32_t next = position[t] + 1u;
+    if (next >= track_steps(t)) {
+      next = 0;
+      wrapped |= (t == 0);
+    }
+    position[t] = (uint8_t)next;
+  }
+  if (!wrapped)
+    return false;
+  if (rewound) {
+    rewound = false;
+    return false;
+  }
+  if (loops_left > 1) {
+    loops_left--;
+    return false;
+  }
+  if (!back)
+    return false;
+  drop(live);
+  live = back;
+  back = nullptr;
+  loops_left = back_loops;
+  memset(position, 0, sizeof(position));
+  return true;
+}
+} // namespace
+
+void engine_post(const EngineCommand &cmd) {
+  // The engine's reference is counted before the pointer can reach it.
+  int i = pool_index(cmd.pattern);
+  if (i >= 0)
+    times_posted[i].store(times_posted[i].load(std::memory_order_relaxed) + 1,
+                          std::memory_order_relaxed);
+  while (!command_ring.push(cmd)) {
+  }
+}
+
+EnginePattern *engine_pattern_acquire() {
+  while (true) {
+    for (uint8_t i = 0; i < PATTERN_POOL; i++) {
+      if (held_by_core0[i] ||
+          times_posted[i].load(std::memory_order_relaxed) !=
+              times_dropped[i].load(std::memory_order_acquire))
+        continue;
+      held_by_core0[i] = true;
+      return &pattern_pool[i];
+    }
+  }
+}
+
+void engine_pattern_release(const EnginePattern *pattern) {
+  int i = pool_index(pattern);
+  if (i >= 0)
+    held_by_core0[i] = false;
+}
+
+bool engine_poll_event(EngineEvent *evt) {
+  if (!event_ring.pop(evt))
+    return false;
+  if (evt->type == ENGINE_EVT_TICK) {
+    ticks_consumed++;
+    uint64_t latency = time_us_64() - evt->time_us;
+    if (latency > max_consume_latency_us)
+      max_consume_latency_us = (uint32_t)latency;
+  }
+  return true;
+}
+
+uint32_t engine_events_dropped() { return events_dropped.load(); }
+
+uint32_t engine_ticks_consumed() { return ticks_consumed; }
+
+uint32_t engine_max_consume_latency_us() { return max_consume_latency_us; }
+
+void engine_reset_consume_stats() {
+  ticks_consumed = 0;
+  max_consume_latency_us = 0;
+}
+
+bool engine_pop_command(EngineCommand *cmd) { return command_ring.pop(cmd); }
+
+void engine_apply(const EngineCommand &cmd) {
+  switch (cmd.type) {
+  case ENGINE_CMD_PLAY:
+    playing = true;
+    break;
+  case ENGINE_CMD_PAUSE:
+    playing = false;
+    break;
+  case ENGINE_CMD_STOP:
+    playing = false;
+    rewind();
+    break;
+  case ENGINE_CMD_SET_PATTERN: {
+    const EnginePattern *newest = pending ? pending : live;
+    if (cmd.base && cmd.base != newest) {
+      drop(cmd.pattern); // derived from a pattern no longer playing
+      break;
+    }
+    drop(pending);
+    pending = cmd.pattern;
+    if (!playing)
+      publish_pending();
+    break;
+  }
+  case ENGINE_CMD_LOAD_PATTERN:
+    drop(pending);
+    pending = nullptr;
+    drop(live);
+    live = cmd.pattern;
+    loops_left = cmd.value ? cmd.value : 1;
+    rewind();
+    break;
+  case ENGINE_CMD_QUEUE_PATTERN:
+    drop(back);
+    back = cmd.pattern;
+    back_loops = cmd.value ? cmd.value : 1;
+    break;
+  case ENGINE_CMD_UNQUEUE_PATTERN:
+    drop(back);
+    back = nullptr;
+    loops_left = 1;
+    break;
+  case ENGINE_CMD_RESET_STATS:
+    events_dropped.store(0);
+    break;
+  case ENGINE_CMD_SET_TEMPO:
+  case ENGINE_CMD_SET_OVERRUN_POLICY:
+    break; // handled by the clock
+  }
+}
+
+void engine_emit(const EngineEvent &evt) {
+  // Only core1 writes the counter, so load + store is not a lost update.
+  if (!event_ring.push(evt))
+    events_dropped.store(events_dropped.load() + 1);
+}
+
+bool engine_tick(uint64_t time_us, SeqStep *out, EngineEvent *evt) {
+  if (!playing)
+    return false;
+
+  publish_pending();
+  bool switched = advance() || switch_unreported;
+  switch_unreported = false;
+
+  *evt = {};
+  evt->time_us = time_us;
+  evt->type = ENGINE_EVT_STEP;
+  evt->pattern_switched = switched;
+
+  uint8_t gates = 0;
+  for (uint8_t t = 0; t < ENGINE_TRACKS; t++) {
+    uint8_t step = position[t];
+    out->note[t] = live->notes[t][step];
+    out->cv_b[t] = live->cv_b[t][step];
+    out->gate_len[t] = gate_length(live->gate_len[t][step]);
+    out->ratchets[t] = ratchet_count(live->ratchets[t][step]);
+    out->offset[t] = step_offset(live->offset[t][step]);
+    gates |= (uint8_t)(((live->gate_mask[t] >> step) & 1u) << t);
+    evt->step[t] = step;
+  }
+  out->gates = gates;
+  return true;
+}
+
+void engine_skip(uint32_t count) {
+  if (!playing)
+    return;
+  publish_pending();
+  while (count--) {
+    if (advance())
+      switch_unreported = true;
+  }
+}
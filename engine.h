@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstdint>
+
+// Real-time sequencer engine running on core1. core0 never touches engine
+// state directly: it posts commands, and the engine reports back through
+// timestamped events. Both directions are lock-free SPSC rings.
+
+// A pattern holds every track, laid out as struct-of-arrays: all notes,
+// then all CV B values, then the gate masks and lengths, so one tick walks
+// a few contiguous rows instead of striding over per-track structs.
+// Track 0 drives the DAC (pitch on channel A, lane B on channel B); every
+// track has its own gate output and its own length.
+//
+// The firmware has four gate outputs. SEQ_ENGINE_TRACKS changes the track
+// count for host benchmarks of the engine alone.
+#ifndef SEQ_ENGINE_TRACKS
+#define SEQ_ENGINE_TRACKS 4
+#endif
+constexpr uint8_t ENGINE_TRACKS = SEQ_ENGINE_TRACKS;
+static_assert(ENGINE_TRACKS >= 1 && ENGINE_TRACKS <= 8,
+              "SeqStep::gates has a bit per track");
+constexpr uint8_t ENGINE_STEPS = 64;
+
+// Per-step timing. The gate length is a percentage of the step (of each
+// ratchet when there are several; 100 ties into the next gate), ratchets
+// split the step into evenly spaced gates, and the offset moves the whole
+// step by a percentage of a step. Zero selects the default, so an all-zero
+// pattern plays plain half-step gates on the grid.
+constexpr uint8_t ENGINE_GATE_DEFAULT = 50;
+constexpr uint8_t ENGINE_GATE_MAX = 100;
+constexpr uint8_t ENGINE_RATCHETS_MAX = 4;
+constexpr int8_t ENGINE_OFFSET_MAX = 50;
+
+struct EnginePattern {
+  uint8_t notes[ENGINE_TRACKS][ENGINE_STEPS];
+  uint16_t cv_b[ENGINE_TRACKS][ENGINE_STEPS];  // 12-bit DAC codes
+  uint8_t gate_len[ENGINE_TRACKS][ENGINE_STEPS];  // percent, 0 = default
+  uint8_t ratchets[ENGINE_TRACKS][ENGINE_STEPS];  // 1-4, 0 = 1
+  int8_t offset[ENGINE_TRACKS][ENGINE_STEPS];     // percent, -50..+50
+  uint64_t gate_mask[ENGINE_TRACKS];  // bit per step
+  uint8_t steps[ENGINE_TRACKS];
+};
+
+// Patterns are immutable once posted. core0 takes a buffer from the
+// engine's pool, fills it and posts its pointer; an edit is a new version
+// of the pattern in a fresh buffer (copy-on-write). The engine switches
+// between versions by pointer and hands buffers back when it drops them, so
+// no pattern is ever copied on core1 and readers on either core see a
+// consistent snapshot without locks.
+enum EngineCommandType : uint8_t {
+  ENGINE_CMD_PLAY,
+  ENGINE_CMD_PAUSE,
+  ENGINE_CMD_STOP,          // pause and rewind
+  ENGINE_CMD_SET_TEMPO,     // centi_bpm
+  ENGINE_CMD_SET_PATTERN,   // pattern, base; keeps the play position
+  ENGINE_CMD_LOAD_PATTERN,  // pattern, value (loops), rewinds
+  ENGINE_CMD_QUEUE_PATTERN, // pattern, value (loops), swapped in at the
+                            // boundary once the live pattern's loops ran out
+  ENGINE_CMD_UNQUEUE_PATTERN, // drop the queued pattern, live one loops on
+  ENGINE_CMD_SET_OVERRUN_POLICY, // value (ClockOverrunPolicy)
+  ENGINE_CMD_RESET_STATS,
+};
+
+// SET_PATTERN publishes an edited version: it replaces the live pattern at
+// the next step boundary (right away while stopped), provided `base`, the
+// version it was derived from, is still the newest one the engine has. A
+// version derived from a pattern the engine already switched away from is
+// dropped. A null base replaces unconditionally.
+struct EngineCommand {
+  EngineCommandType type;
+  uint8_t value;
+  uint32_t centi_bpm;
+  const EnginePattern *pattern;
+  const EnginePattern *base;
+};
+
+enum EngineEventType : uint8_t {
+  ENGINE_EVT_TICK,
+  ENGINE_EVT_STEP,
+  ENGINE_EVT_OVERRUN,
+};
+
+struct EngineEvent {
+  uint64_t time_us;  // scheduled time of the tick that produced the event
+  EngineEventType type;
+  uint8_t step[ENGINE_TRACKS];  // STEP: play head of every track
+  bool pattern_switched;  // STEP: the queued pattern became live
+  uint8_t count;          // OVERRUN: ticks skipped (0 = caught up late)
+};
+
+// Output of every track for one tick, evaluated in a single pass. The
+// timing fields are resolved: defaults applied and values in range.
+struct SeqStep {
+  uint8_t note[ENGINE_TRACKS];
+  uint16_t cv_b[ENGINE_TRACKS];
+  uint8_t gate_len[ENGINE_TRACKS];  // percent, 1-100
+  uint8_t ratchets[ENGINE_TRACKS];  // 1-4
+  int8_t offset[ENGINE_TRACKS];     // percent, -50..+50
+  uint8_t gates;  // bit per track
+};
+
+// core0 side. engine_post() waits for space if the ring is full (core1
+// drains it continuously, so the wait is bounded).
+void engine_post(const EngineCommand &cmd);
+
+// Pattern buffers, core0 side. engine_pattern_acquire() returns a buffer
+// that neither core references, waiting for core1 to drop one if needed.
+// core0 keeps its reference until engine_pattern_release(); posting the
+// pointer gives the engine a reference of its own.
+EnginePattern *engine_pattern_acquire();
+void engine_pattern_release(const EnginePattern *pattern);
+bool engine_poll_event(EngineEvent *evt);
+
+// Events dropped because core0 fell behind.
+uint32_t engine_events_dropped();
+
+// Tick events drained by core0, and the worst delay between a tick's
+// scheduled time and core0 picking up its event.
+uint32_t engine_ticks_consumed();
+uint32_t engine_max_consume_latency_us();
+void engine_reset_consume_stats();
+
+// core1 side. Commands, ticks and skips run in core1's thread;
+// engine_emit() runs in the output IRQ only (one producer context).
+bool engine_pop_command(EngineCommand *cmd);
+void engine_apply(const EngineCommand &cmd);
+void engine_emit(const EngineEvent &evt);
+
+// Advance every track's play head for the tick due at `time_us` and return
+// the steps to output, plus the STEP event for the caller to emit once the
+// tick's time has come. Returns false while stopped.
+bool engine_tick(uint64_t time_us, SeqStep *out, EngineEvent *evt);
+
+// Advance the play heads by `count` steps without output (ticks dropped
+// by the skip overrun policy). A pattern switch on the way is reported with
+// the next STEP event.
+void engine_skip(uint32_t count);
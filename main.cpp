@@ -2,15 +2,21 @@
 
 #include "clock.h"
 #include "io.h"
+#include "pattern_store.h"
+#include "pitch.h"
+#include "profile.h"
 #include "sequencer.h"
+#include "trace.h"
 #include "ui.h"
 
 int main() {
+    stdio_init_all();
+    profile_init();
     io_init();
     io_encoder_init();
     seq_init();
     seq_init_flash();
-    seq_load_pattern(0);
+    pitch_init();
 
     clock_set_bpm(seq_get_bpm());
     clock_launch_core1();
@@ -18,243 +24,317 @@ int main() {
     ui_init();
     ui_boot_animation();
     ui_show_bpm(seq_get_bpm(), 0);
-    ui_show_steps(16, seq_get_steps());
+    ui_show_steps(ENGINE_STEPS, seq_get_steps());
 
-    constexpr uint8_t MIDI_BASE = 36;
-    constexpr float DAC_PER_SEMITONE = 4096.0f / 48.0f;
-
-    enum EditMode { EDIT_NONE, EDIT_SELECT_STEP, EDIT_NOTE, PATTERN_SELECT };
+    enum EditMode { EDIT_NONE, EDIT_SELECT_STEP, EDIT_NOTE, EDIT_TIMING, PATTERN_SELECT };
     EditMode edit_mode = EDIT_NONE;
     uint32_t edit_step = 0;
+    TimingField timing_field = TIMING_GATE_LENGTH;
     uint8_t pattern_slot = 0;
     uint8_t temp_pattern_slot = 0;
     
     bool blink_active = false;
     uint64_t blink_start_time = 0;
+    uint64_t blink_duration = 0;
     uint8_t blink_slot = 0;
     
     int encoder_step = 1;
     while (true) {
-        io_update_led();
-        
-        if (blink_active) {
-            uint64_t elapsed = time_us_64() - blink_start_time;
-            if (elapsed >= 150000) {
-                clear_region(48, 16, 32, 32);
-                char slot_char = '0' + blink_slot;
-                draw_scaled_char(56, 24, slot_char, 3);
-                ssd1306_update();
-                blink_active = false;
-            }
-        }
+        PROFILE_ZONE(PROF_LOOP);
 
-        if (io_poll_play_toggle()) {
-            bool was_playing = seq_is_playing();
-            bool is_playing = seq_toggle_play();
-            
-            if (is_playing) {
-                uint32_t start_step = seq_current_step() + 1;
-                if (start_step >= seq_get_steps()) start_step = 0;
-                bool first_gate = seq_get_gate_enabled(start_step);
-                clock_gate_enable(first_gate);
-            } else {
-                clock_gate_enable(false);
-                if (was_playing && seq_has_dirty_patterns()) {
-                    seq_flush_all_patterns_to_eeprom();
-                }
-            }
-        }
+        {
+            PROFILE_ZONE(PROF_SERVICE);
+            io_update_led();
+            seq_storage_service();
 
-        if (io_poll_stop_button()) {
-            seq_stop();
-            clock_gate_enable(false);
-            
-            if (seq_has_dirty_patterns()) {
-                seq_flush_all_patterns_to_eeprom();
+            int c = getchar_timeout_us(0);
+            if (c != PICO_ERROR_TIMEOUT && !trace_command(c) && !profile_command(c) &&
+                !store_command(c) && !clock_command(c) && !ui_command(c)) {
+                pitch_command(c);
             }
-            
-            if (edit_mode == EDIT_NONE) {
-                ui_show_bpm(seq_get_bpm(), pattern_slot);
-                ui_show_steps(seq_get_steps(), seq_get_steps());
-            } else if (edit_mode == PATTERN_SELECT) {
-                ui_show_pattern_select(temp_pattern_slot);
+        
+            if (blink_active) {
+                uint64_t elapsed = time_us_64() - blink_start_time;
+                if (elapsed >= blink_duration) {
+                    if (edit_mode == PATTERN_SELECT) {
+                        ui_show_pattern_select(blink_slot);
+                    }
+                    blink_active = false;
+                }
             }
         }
 
-        if (io_poll_edit_toggle()) {
-            if (edit_mode == EDIT_NONE) {
-                edit_mode = EDIT_SELECT_STEP;
-                edit_step = 0;
-                ui_show_edit_step(edit_step, seq_get_note(edit_step));
-            } else if (edit_mode == EDIT_SELECT_STEP || edit_mode == EDIT_NOTE) {
-                edit_mode = EDIT_NONE;
-                ui_clear();
-                ui_show_bpm(seq_get_bpm(), pattern_slot);
-                ui_show_steps(seq_current_step(), seq_get_steps());
-            } else if (edit_mode == PATTERN_SELECT) {
-                edit_mode = EDIT_SELECT_STEP;
-                edit_step = 0;
-                ui_show_edit_step(edit_step, seq_get_note(edit_step));
+        {
+            PROFILE_ZONE(PROF_BUTTONS);
+            if (io_poll_play_toggle()) {
+                seq_toggle_play();
             }
-        }
 
-        if (io_poll_pattern_select_button()) {
-            if (edit_mode == EDIT_NONE) {
-                edit_mode = PATTERN_SELECT;
-                temp_pattern_slot = pattern_slot;
-                ui_show_pattern_select(temp_pattern_slot);
-            } else if (edit_mode == EDIT_SELECT_STEP || edit_mode == EDIT_NOTE) {
-                edit_mode = PATTERN_SELECT;
-                temp_pattern_slot = pattern_slot;
-                ui_show_pattern_select(temp_pattern_slot);
-            } else if (edit_mode == PATTERN_SELECT) {
-                edit_mode = EDIT_NONE;
-                if (!seq_is_playing()) {
-                    ui_clear();
+            if (io_poll_stop_button()) {
+                if (edit_mode == PATTERN_SELECT && io_is_step_button_pressed()) {
+                    // Step button held: stop clears the song chain instead.
+                    seq_chain_clear();
+                    ui_show_pattern_select(temp_pattern_slot);
+                } else {
+                    seq_stop();
+                }
+            
+                if (edit_mode == EDIT_NONE) {
                     ui_show_bpm(seq_get_bpm(), pattern_slot);
                     ui_show_steps(seq_get_steps(), seq_get_steps());
-                } else {
+                } else if (edit_mode == PATTERN_SELECT) {
+                    ui_show_pattern_select(temp_pattern_slot);
+                }
+            }
+
+            if (io_poll_edit_toggle()) {
+                if (edit_mode == EDIT_NONE) {
+                    edit_mode = EDIT_SELECT_STEP;
+                    edit_step = 0;
+                    ui_show_edit_step(edit_step, seq_get_note(edit_step));
+                } else if (edit_mode == EDIT_SELECT_STEP || edit_mode == EDIT_NOTE ||
+                           edit_mode == EDIT_TIMING) {
+                    edit_mode = EDIT_NONE;
                     ui_clear();
                     ui_show_bpm(seq_get_bpm(), pattern_slot);
                     ui_show_steps(seq_current_step(), seq_get_steps());
+                } else if (edit_mode == PATTERN_SELECT) {
+                    edit_mode = EDIT_SELECT_STEP;
+                    edit_step = 0;
+                    ui_show_edit_step(edit_step, seq_get_note(edit_step));
                 }
             }
-        }
 
-        if (io_encoder_button_pressed()) {
-            if (edit_mode == EDIT_SELECT_STEP) {
-                edit_mode = EDIT_NOTE;
-                ui_clear();
-                ui_show_edit_note(edit_step, seq_get_note(edit_step));
-            } else if (edit_mode == EDIT_NOTE) {
-                edit_mode = EDIT_SELECT_STEP;
-                ui_clear();
-                ui_show_edit_step(edit_step, seq_get_note(edit_step));
-            } else if (edit_mode == PATTERN_SELECT) {
-                if (seq_is_playing()) {
-                    seq_queue_pattern(temp_pattern_slot);
+            if (io_poll_pattern_select_button()) {
+                if (edit_mode == EDIT_NONE) {
+                    edit_mode = PATTERN_SELECT;
+                    temp_pattern_slot = pattern_slot;
+                    ui_show_pattern_select(temp_pattern_slot);
+                } else if (edit_mode == EDIT_SELECT_STEP || edit_mode == EDIT_NOTE ||
+                           edit_mode == EDIT_TIMING) {
+                    edit_mode = PATTERN_SELECT;
+                    temp_pattern_slot = pattern_slot;
+                    ui_show_pattern_select(temp_pattern_slot);
+                } else if (edit_mode == PATTERN_SELECT) {
+                    edit_mode = EDIT_NONE;
+                    if (!seq_is_playing()) {
+                        ui_clear();
+                        ui_show_bpm(seq_get_bpm(), pattern_slot);
+                        ui_show_steps(seq_get_steps(), seq_get_steps());
+                    } else {
+                        ui_clear();
+                        ui_show_bpm(seq_get_bpm(), pattern_slot);
+                        ui_show_steps(seq_current_step(), seq_get_steps());
+                    }
+                }
+            }
+
+            if (io_encoder_button_pressed()) {
+                // Step select -> note edit -> timing edit -> step select. Only
+                // track 0 has a pitch output, so only it has note edit, and only
+                // its timing is stored: the other tracks stay in step select.
+                if (edit_mode == EDIT_SELECT_STEP && seq_get_track() == 0) {
+                    edit_mode = EDIT_NOTE;
+                    ui_clear();
+                    ui_show_edit_note(edit_step, seq_get_note(edit_step));
+                } else if (edit_mode == EDIT_SELECT_STEP) {
+                    // Gates only on this track.
+                } else if (edit_mode == EDIT_NOTE) {
+                    edit_mode = EDIT_TIMING;
+                    ui_clear();
+                    ui_show_edit_timing(edit_step, timing_field);
+                } else if (edit_mode == EDIT_TIMING) {
+                    edit_mode = EDIT_SELECT_STEP;
+                    ui_clear();
+                    ui_show_edit_step(edit_step, seq_get_note(edit_step));
+                } else if (edit_mode == PATTERN_SELECT) {
+                    if (io_is_step_button_pressed()) {
+                        // Step button held: play the song chain instead.
+                        seq_chain_start();
+                        if (!seq_is_playing()) pattern_slot = seq_get_slot();
+                    } else {
+                        if (seq_is_playing()) {
+                            seq_queue_pattern(temp_pattern_slot);
+                        } else {
+                            seq_load_pattern(temp_pattern_slot);
+                        }
+                        pattern_slot = temp_pattern_slot;
+                    }
+                    edit_mode = EDIT_NONE;
+                    ui_clear();
+                    ui_show_bpm(seq_get_bpm(), pattern_slot);
+                    ui_show_steps(seq_is_playing() ? seq_current_step() : seq_get_steps(), seq_get_steps());
                 } else {
-                    seq_load_pattern(temp_pattern_slot);
+                    encoder_step = (encoder_step == 1) ? 10 : 1;
                 }
-                pattern_slot = temp_pattern_slot;
-                edit_mode = EDIT_NONE;
-                ui_clear();
-                ui_show_bpm(seq_get_bpm(), pattern_slot);
-                ui_show_steps(seq_is_playing() ? seq_current_step() : seq_get_steps(), seq_get_steps());
-            } else {
-                encoder_step = (encoder_step == 1) ? 10 : 1;
             }
         }
 
-        int encoder_delta = io_encoder_poll_delta();
-        if (encoder_delta != 0) {
-            if (edit_mode == EDIT_SELECT_STEP) {
-                int new_step = (int)edit_step + encoder_delta;
-                if (new_step < 0) new_step = 0;
-                if (new_step > 15) new_step = 15;
-                edit_step = (uint32_t)new_step;
-                ui_show_edit_step(edit_step, seq_get_note(edit_step));
+        {
+            PROFILE_ZONE(PROF_ENCODER);
+            int encoder_delta = io_encoder_poll_delta();
+            if (encoder_delta != 0) {
+                if (edit_mode == EDIT_SELECT_STEP && io_is_step_button_pressed()) {
+                    // Step button held: the encoder picks the track.
+                    int new_track = (int)seq_get_track() + encoder_delta;
+                    if (new_track < 0) new_track = 0;
+                    if (new_track > ENGINE_TRACKS - 1) new_track = ENGINE_TRACKS - 1;
+                    seq_select_track((uint8_t)new_track);
+                    ui_show_edit_step(edit_step, seq_get_note(edit_step));
+                
+                } else if (edit_mode == EDIT_SELECT_STEP) {
+                    int new_step = (int)edit_step + encoder_delta;
+                    if (new_step < 0) new_step = 0;
+                    if (new_step > ENGINE_STEPS - 1) new_step = ENGINE_STEPS - 1;
+                    edit_step = (uint32_t)new_step;
+                    ui_show_edit_step(edit_step, seq_get_note(edit_step));
+                
+                } else if (edit_mode == EDIT_NOTE && io_is_step_button_pressed()) {
+                    // Step button held: the encoder edits the CV B lane.
+                    int new_cv = (int)seq_get_cv_b(edit_step) + encoder_delta * 16;
+                    if (new_cv < 0) new_cv = 0;
+                    if (new_cv > 4095) new_cv = 4095;
+                    seq_set_cv_b(edit_step, (uint16_t)new_cv);
+                    ui_show_edit_note(edit_step, seq_get_note(edit_step));
                 
-            } else if (edit_mode == EDIT_NOTE) {
-                uint8_t current_note = seq_get_note(edit_step);
-                int new_note = (int)current_note + encoder_delta;
-                if (new_note < 36) new_note = 36;
-                if (new_note > 84) new_note = 84;
-                seq_set_note(edit_step, (uint8_t)new_note);
-                ui_show_edit_note(edit_step, (uint8_t)new_note);
+                } else if (edit_mode == EDIT_NOTE) {
+                    uint8_t current_note = seq_get_note(edit_step);
+                    int new_note = (int)current_note + encoder_delta;
+                    if (new_note < 36) new_note = 36;
+                    if (new_note > 84) new_note = 84;
+                    seq_set_note(edit_step, (uint8_t)new_note);
+                    ui_show_edit_note(edit_step, (uint8_t)new_note);
                 
-            } else if (edit_mode == PATTERN_SELECT) {
-                int new_slot = (int)temp_pattern_slot + encoder_delta;
-                if (new_slot < 0) new_slot = 0;
-                if (new_slot > 9) new_slot = 9;
-                temp_pattern_slot = (uint8_t)new_slot;
-                ui_show_pattern_select(temp_pattern_slot);
+                } else if (edit_mode == EDIT_TIMING && io_is_step_button_pressed()) {
+                    // Step button held: the encoder picks the field.
+                    int new_field = (int)timing_field + encoder_delta;
+                    if (new_field < 0) new_field = 0;
+                    if (new_field > TIMING_FIELDS - 1) new_field = TIMING_FIELDS - 1;
+                    timing_field = (TimingField)new_field;
+                    ui_show_edit_timing(edit_step, timing_field);
+                
+                } else if (edit_mode == EDIT_TIMING) {
+                    if (timing_field == TIMING_GATE_LENGTH) {
+                        int new_length = (int)seq_get_gate_length(edit_step) + encoder_delta;
+                        if (new_length < 1) new_length = 1;
+                        if (new_length > ENGINE_GATE_MAX) new_length = ENGINE_GATE_MAX;
+                        seq_set_gate_length(edit_step, (uint8_t)new_length);
+                    } else if (timing_field == TIMING_RATCHETS) {
+                        int new_count = (int)seq_get_ratchets(edit_step) + encoder_delta;
+                        if (new_count < 1) new_count = 1;
+                        if (new_count > ENGINE_RATCHETS_MAX) new_count = ENGINE_RATCHETS_MAX;
+                        seq_set_ratchets(edit_step, (uint8_t)new_count);
+                    } else {
+                        int new_offset = (int)seq_get_offset(edit_step) + encoder_delta;
+                        if (new_offset < -ENGINE_OFFSET_MAX) new_offset = -ENGINE_OFFSET_MAX;
+                        if (new_offset > ENGINE_OFFSET_MAX) new_offset = ENGINE_OFFSET_MAX;
+                        seq_set_offset(edit_step, (int8_t)new_offset);
+                    }
+                    ui_show_edit_timing(edit_step, timing_field);
+                
+                } else if (edit_mode == PATTERN_SELECT) {
+                    int new_slot = (int)temp_pattern_slot + encoder_delta;
+                    if (new_slot < 0) new_slot = 0;
+                    if (new_slot > STORE_SLOTS - 1) new_slot = STORE_SLOTS - 1;
+                    temp_pattern_slot = (uint8_t)new_slot;
+                    ui_show_pattern_select(temp_pattern_slot);
                 
-            } else {
-                if (io_is_step_button_pressed()) {
-                    uint32_t current_steps = seq_get_steps();
-                    int new_steps = (int)current_steps + encoder_delta;
-                    if (new_steps < 1) new_steps = 1;
-                    if (new_steps > 16) new_steps = 16;
-                    seq_set_steps((uint32_t)new_steps);
-                    ui_show_steps(seq_is_playing() ? seq_current_step() : 16, (uint32_t)new_steps);
                 } else {
-                    uint32_t current_bpm = seq_get_bpm();
-                    int new_bpm = (int)current_bpm + encoder_delta * encoder_step;
-                    if (new_bpm < 20) new_bpm = 20;
-                    if (new_bpm > 300) new_bpm = 300;
+                    if (io_is_step_button_pressed()) {
+                        uint32_t current_steps = seq_get_steps();
+                        int new_steps = (int)current_steps + encoder_delta;
+                        if (new_steps < 1) new_steps = 1;
+                        if (new_steps > ENGINE_STEPS) new_steps = ENGINE_STEPS;
+                        seq_set_steps((uint32_t)new_steps);
+                        ui_show_steps(seq_is_playing() ? seq_current_step() : ENGINE_STEPS, (uint32_t)new_steps);
+                    } else {
+                        uint32_t current_bpm = seq_get_bpm();
+                        int new_bpm = (int)current_bpm + encoder_delta * encoder_step;
+                        if (new_bpm < 20) new_bpm = 20;
+                        if (new_bpm > 300) new_bpm = 300;
                     
-                    seq_set_bpm((uint32_t)new_bpm);
-                    clock_set_bpm((uint32_t)new_bpm);
-                    ui_show_bpm((uint32_t)new_bpm, pattern_slot);
+                        seq_set_bpm((uint32_t)new_bpm);
+                        clock_set_bpm((uint32_t)new_bpm);
+                        ui_show_bpm((uint32_t)new_bpm, pattern_slot);
+                    }
                 }
             }
         }
 
-        if (edit_mode == EDIT_SELECT_STEP || edit_mode == EDIT_NOTE) {
-            if (io_poll_save_button()) {
-                seq_toggle_gate(edit_step);
-                if (edit_mode == EDIT_SELECT_STEP) {
-                    ui_show_edit_step(edit_step, seq_get_note(edit_step));
-                } else {
-                    ui_show_edit_note(edit_step, seq_get_note(edit_step));
-                }
-            }
-        } else if (edit_mode == PATTERN_SELECT) {
-            if (io_poll_save_button()) {
-                seq_save_pattern_ram_only(temp_pattern_slot);
-                if (!seq_is_playing()) {
-                    seq_flush_all_patterns_to_eeprom();
+        {
+            PROFILE_ZONE(PROF_SAVE);
+            if (edit_mode == EDIT_SELECT_STEP || edit_mode == EDIT_NOTE ||
+                edit_mode == EDIT_TIMING) {
+                if (io_poll_save_button()) {
+                    seq_toggle_gate(edit_step);
+                    if (edit_mode == EDIT_SELECT_STEP) {
+                        ui_show_edit_step(edit_step, seq_get_note(edit_step));
+                    } else if (edit_mode == EDIT_TIMING) {
+                        ui_show_edit_timing(edit_step, timing_field);
+                    } else {
+                        ui_show_edit_note(edit_step, seq_get_note(edit_step));
+                    }
                 }
-                pattern_slot = temp_pattern_slot;
+            } else if (edit_mode == PATTERN_SELECT) {
+                if (io_poll_save_button()) {
+                    bool saved;
+                    if (io_is_step_button_pressed()) {
+                        // Step button held: append the slot to the song chain.
+                        saved = seq_chain_append(temp_pattern_slot);
+                    } else {
+                        saved = seq_save_pattern(temp_pattern_slot);
+                        pattern_slot = temp_pattern_slot;
+                    }
                 
-                clear_region(48, 16, 32, 32);
-                ssd1306_update();
-                blink_active = true;
-                blink_start_time = time_us_64();
-                blink_slot = temp_pattern_slot;
+                    // A refused save keeps its notice up longer than the
+                    // confirmation blink, with the slot still shown.
+                    ui_show_pattern_select(temp_pattern_slot, saved, !saved);
+                    blink_active = true;
+                    blink_start_time = time_us_64();
+                    blink_duration = saved ? 150000 : 1500000;
+                    blink_slot = temp_pattern_slot;
+                }
             }
         }
 
-        if (clock_consume_tick()) {
-            if (!seq_is_playing()) {
-                tight_loop_contents();
-                continue;
+        {
+            PROFILE_ZONE(PROF_EVENTS);
+            bool stepped = false;
+            EngineEvent evt;
+            while (seq_poll_event(&evt)) {
+                if (evt.type == ENGINE_EVT_TICK) {
+                    ui_flush_stats_tick();
+                } else if (evt.type == ENGINE_EVT_STEP) {
+                    stepped = true;
+                }
             }
 
-            seq_advance_step();
-
-            uint32_t cur = seq_current_step();
-            uint8_t midi_note = seq_get_note(cur);
-            
-            int32_t semitones = (int32_t)midi_note - MIDI_BASE;
-            int32_t dac_val = (int32_t)(semitones * DAC_PER_SEMITONE + 0.5f);
-            
-            if (dac_val < 0) dac_val = 0;
-            if (dac_val > 0x0FFF) dac_val = 0x0FFF;
-            
-            clock_set_cv((uint16_t)dac_val);
-            
-            uint32_t next_step = (cur + 1) % seq_get_steps();
-            bool next_gate_enabled = seq_get_gate_enabled(next_step);
-            clock_gate_enable(next_gate_enabled);
-
-            if (edit_mode == EDIT_NONE) {
-                ui_show_steps(seq_current_step(), seq_get_steps());
+            // Core1 has already written the CV and gate for this step.
+            if (stepped) {
+                TRACE_EVENT(TRACE_UI_STEP);
+                // A chain moves through its slots on its own.
+                if (seq_chain_active()) pattern_slot = seq_get_slot();
+                if (edit_mode == EDIT_NONE) {
+                    ui_show_steps(seq_current_step(), seq_get_steps());
                 
-                int8_t pending = seq_get_pending_pattern();
-                bool blink = false;
-                if (pending >= 0) {
-                    blink = (seq_current_step() % 4 < 2);
+                    int8_t pending = seq_get_pending_pattern();
+                    bool blink = false;
+                    if (pending >= 0 && !seq_chain_active()) {
+                        blink = (seq_current_step() % 4 < 2);
+                    }
+                    ui_show_bpm(seq_get_bpm(), pattern_slot, blink);
                 }
-                ui_show_bpm(seq_get_bpm(), pattern_slot, blink);
-            }
 
-            if (seq_current_step() % 4 == 0) {
-                io_blink_led_start();
+                if (seq_current_step() % 4 == 0) {
+                    io_blink_led_start();
+                }
             }
         }
 
+        {
+            PROFILE_ZONE(PROF_COMMIT);
+            ui_commit();
+        }
         tight_loop_contents();
     }
 }
\ No newline at end of file
@@ -0,0 +1,400 @@
+#include "pattern_store.h"
+
+#include "pico/stdlib.h"
+#include <cstdio>
+#include <cstring>
+
+namespace {
+constexpr uint8_t FACTORY_SLOTS = 10;
+constexpr uint8_t FACTORY_STEPS = 16;
+constexpr uint8_t EMPTY_NOTE = 48;
+constexpr uint8_t IDLE_TRACK_NOTE = 60;
+
+// Factory patterns for slots 0-9, repeated over every page. The other slots
+// start empty.
+constexpr uint8_t DEFAULT_PATTERNS[FACTORY_SLOTS][FACTORY_STEPS] = {
+    // Pattern 0: C Major Scale (C3 to C4)
+    {48, 50, 52, 53, 55, 57, 59, 60, 59, 57, 55, 53, 52, 50, 48, 60},
+    // Pattern 1: Minor Arpeggio (Am)
+    {57, 60, 64, 69, 64, 60, 57, 69, 57, 60, 64, 69, 72, 69, 64, 60},
+    // Pattern 2: Pentatonic Sequence
+    {60, 62, 65, 67, 70, 72, 70, 67, 65, 62, 60, 67, 65, 70, 62, 72},
+    // Pattern 3: Bass Line (Techno Style)
+    {36, 48, 36, 43, 36, 48, 40, 36, 38, 50, 38, 45, 38, 50, 43, 38},
+    // Pattern 4: Octave Jump Pattern
+    {48, 60, 50, 62, 52, 64, 53, 65, 55, 67, 57, 69, 59, 71, 60, 72},
+    // Pattern 5: Chord Progression (C-F-G-Am)
+    {48, 52, 55, 60, 53, 57, 60, 65, 55, 59, 62, 67, 57, 60, 64, 69},
+    // Pattern 6: Ambient Pad
+    {60, 64, 67, 72, 67, 64, 60, 72, 62, 65, 69, 74, 69, 65, 62, 74},
+    // Pattern 7: Chromatic Walk
+    {60, 61, 62, 63, 64, 65, 66, 67, 68, 69, 70, 71, 72, 71, 70, 69},
+    // Pattern 8: Melodic Sequence (Uplifting)
+    {60, 64, 67, 72, 64, 67, 72, 76, 67, 72, 76, 79, 72, 76, 79, 84},
+    // Pattern 9: Rhythmic Pattern (Hi-Low)
+    {72, 48, 72, 60, 74, 50, 74, 62, 76, 52, 76, 64, 77, 53, 77, 65}};
+
+// 16 pages: four full-length patterns, about 2 KB.
+constexpr uint8_t CACHE_PAGES = 16;
+
+struct CacheEntry {
+  uint8_t slot;
+  uint8_t page;
+  bool valid;
+  bool dirty;
+  bool unfit; // dirty but refused by the EEPROM: kept until saved again
+  uint32_t last_use;
+  PatternPage data;
+};
+
+CacheEntry cache[CACHE_PAGES];
+// Stands in for a cache entry when every entry is pinned. Only a load reads
+// through it; a save writes it out at once.
+CacheEntry scratch;
+uint32_t use_clock = 0;
+StoreStats stats = {};
+
+// Background write-back. The entry being written is pinned: it cannot be
+// evicted until its job ends. A save that lands meanwhile re-dirties it and
+// it is written again.
+int8_t in_flight = -1;
+
+// The song chain waits here for its own job, ahead of any page.
+struct PendingChain {
+  uint8_t slots[EEPROM_CHAIN_LENGTH];
+  uint8_t repeats[EEPROM_CHAIN_LENGTH];
+  uint8_t length;
+  bool dirty;
+  bool unfit;
+  bool in_flight;
+};
+PendingChain pending_chain = {};
+uint64_t last_commit_us = 0;
+bool committed = false;
+
+void default_page(uint8_t slot, uint8_t page, PatternPage *out) {
+  *out = {};
+  if (slot < FACTORY_SLOTS) {
+    memcpy(out->notes, DEFAULT_PATTERNS[slot], EEPROM_PAGE_STEPS);
+    out->gate_mask[0] = 0xFFFF;
+  } else {
+    memset(out->notes, EMPTY_NOTE, EEPROM_PAGE_STEPS);
+  }
+  if (page == 0)
+    memset(out->steps, FACTORY_STEPS, sizeof(out->steps));
+}
+
+// Split a pattern into its storage pages and back. The other tracks keep
+// only gates and lengths (see PatternPage).
+void page_of(const EnginePattern &pattern, uint8_t page, PatternPage *out) {
+  uint8_t first = page * EEPROM_PAGE_STEPS;
+  *out = {};
+  memcpy(out->notes, &pattern.notes[0][first], EEPROM_PAGE_STEPS);
+  memcpy(out->cv_b, &pattern.cv_b[0][first], sizeof(out->cv_b));
+  memcpy(out->gate_len, &pattern.gate_len[0][first], EEPROM_PAGE_STEPS);
+  memcpy(out->ratchets, &pattern.ratchets[0][first], EEPROM_PAGE_STEPS);
+  memcpy(out->offset, &pattern.offset[0][first], EEPROM_PAGE_STEPS);
+  for (uint8_t t = 0; t < ENGINE_TRACKS; t++) {
+    out->gate_mask[t] = (uint16_t)(pattern.gate_mask[t] >> first);
+    if (page == 0)
+      out->steps[t] = pattern.steps[t];
+  }
+}
+
+void merge_page(const PatternPage &in, uint8_t page, EnginePattern *pattern) {
+  uint8_t first = page * EEPROM_PAGE_STEPS;
+  memcpy(&pattern->notes[0][first], in.notes, EEPROM_PAGE_STEPS);
+  memcpy(&pattern->cv_b[0][first], in.cv_b, sizeof(in.cv_b));
+  memcpy(&pattern->gate_len[0][first], in.gate_len, EEPROM_PAGE_STEPS);
+  memcpy(&pattern->ratchets[0][first], in.ratchets, EEPROM_PAGE_STEPS);
+  memcpy(&pattern->offset[0][first], in.offset, EEPROM_PAGE_STEPS);
+  for (uint8_t t = 0; t < ENGINE_TRACKS; t++) {
+    pattern->gate_mask[t] |= (uint64_t)in.gate_mask[t] << first;
+    if (page == 0)
+      pattern->steps[t] = in.steps[t];
+  }
+}
+
+int find(uint8_t slot, uint8_t page) {
+  for (uint8_t i = 0; i < CACHE_PAGES; i++) {
+    if (cache[i].valid && cache[i].slot == slot && cache[i].page == page)
+      return i;
+  }
+  return -1;
+}
+
+// Least recently used entry to replace: a free one if any, else the oldest
+// clean one. When every candidate is dirty the oldest is written back first,
+// synchronously; a page the EEPROM refuses is kept and the next one tried.
+// Returns nullptr when every entry is pinned (in flight or refused).
+CacheEntry *victim() {
+  while (true) {
+    int clean = -1, dirty = -1;
+    for (uint8_t i = 0; i < CACHE_PAGES; i++) {
+      const CacheEntry &e = cache[i];
+      if (!e.valid)
+        return &cache[i];
+      if (i == in_flight || e.unfit)
+        continue;
+      int &best = e.dirty ? dirty : clean;
+      if (best < 0 || e.last_use < cache[best].last_use)
+        best = i;
+    }
+    if (clean < 0 && dirty < 0)
+      return nullptr;
+
+    CacheEntry &e = cache[clean >= 0 ? clean : dirty];
+    if (e.dirty) {
+      stats.sync_flushes++;
+      if (!eeprom_write_page(e.slot, e.page, e.data)) {
+        e.unfit = true;
+        continue;
+      }
+    }
+    stats.evictions++;
+    e.valid = false;
+    return &e;
+  }
+}
+
+// Cached page, fetched on a miss. Falls back to the scratch entry when the
+// cache cannot take another page.
+CacheEntry &acquire(uint8_t slot, uint8_t page) {
+  int i = find(slot, page);
+  if (i >= 0) {
+    stats.hits++;
+    cache[i].last_use = ++use_clock;
+    return cache[i];
+  }
+
+  stats.misses++;
+  CacheEntry *slot_entry = victim();
+  CacheEntry &e = slot_entry ? *slot_entry : scratch;
+  e.slot = slot;
+  e.page = page;
+  e.valid = true;
+  e.dirty = false;
+  e.unfit = false;
+  e.last_use = ++use_clock;
+  default_page(slot, page, &e.data);
+  eeprom_read_page(slot, page, &e.data);
+  return e;
+}
+
+// Current content of a page, from the cache or the EEPROM, without
+// touching the cache.
+void peek(uint8_t slot, uint8_t page, PatternPage *out) {
+  int i = find(slot, page);
+  if (i >= 0) {
+    *out = cache[i].data;
+    return;
+  }
+  default_page(slot, page, out);
+  eeprom_read_page(slot, page, out);
+}
+
+// Records still to be written for pages outside `slot` (none with
+// STORE_SLOTS) and, unless `skip_chain`, for the chain: dirty ones and the
+// one in flight, whose records may not all be committed yet.
+uint32_t pending_records(uint8_t slot, bool skip_chain) {
+  uint32_t records = 0;
+  for (uint8_t i = 0; i < CACHE_PAGES; i++) {
+    const CacheEntry &e = cache[i];
+    if (e.valid && e.slot != slot && (e.dirty || i == in_flight))
+      records += eeprom_page_new_records(e.slot, e.page, e.data);
+  }
+  if (!skip_chain && (pending_chain.dirty || pending_chain.in_flight))
+    records += eeprom_chain_new_records(pending_chain.length);
+  return records;
+}
+
+void print_stats() {
+  uint32_t lookups = stats.hits + stats.misses;
+  printf("store hits %lu misses %lu (%lu%% hit) evictions %lu sync_flushes %lu"
+         " dirty %lu records %lu/%lu\n",
+         (unsigned long)stats.hits, (unsigned long)stats.misses,
+         (unsigned long)(lookups ? stats.hits * 100ull / lookups : 0),
+         (unsigned long)stats.evictions, (unsigned long)stats.sync_flushes,
+         (unsigned long)store_queue_depth(),
+         (unsigned long)eeprom_records_live(),
+         (unsigned long)eeprom_records_total());
+}
+} // namespace
+
+void store_init() {
+  memset(cache, 0, sizeof(cache));
+  scratch = {};
+  pending_chain = {};
+  in_flight = -1;
+  use_clock = 0;
+}
+
+void store_load(uint8_t slot, EnginePattern *pattern) {
+  *pattern = {};
+  if (slot >= STORE_SLOTS)
+    slot = 0;
+  for (uint8_t t = 1; t < ENGINE_TRACKS; t++)
+    memset(pattern->notes[t], IDLE_TRACK_NOTE, ENGINE_STEPS);
+  for (uint8_t page = 0; page < EEPROM_PAGES; page++)
+    merge_page(acquire(slot, page).data, page, pattern);
+}
+
+bool store_save(uint8_t slot, const EnginePattern &pattern) {
+  if (slot >= STORE_SLOTS)
+    return false;
+
+  if (!store_fits(slot, pattern))
+    return false;
+
+  PatternPage pages[EEPROM_PAGES];
+  for (uint8_t page = 0; page < EEPROM_PAGES; page++)
+    page_of(pattern, page, &pages[page]);
+
+  bool persist = eeprom_is_initialized();
+  bool stored = true;
+  for (uint8_t page = 0; page < EEPROM_PAGES; page++) {
+    CacheEntry &e = acquire(slot, page);
+    if (memcmp(&e.data, &pages[page], sizeof(pages[page])) == 0)
+      continue;
+    e.data = pages[page];
+    e.unfit = false;
+    if (&e == &scratch) {
+      // No cache entry free: write through.
+      stats.sync_flushes++;
+      stored &= !persist || eeprom_write_page(slot, page, e.data);
+      continue;
+    }
+    e.dirty = persist;
+  }
+  return stored;
+}
+
+bool store_fits(uint8_t slot, const EnginePattern &pattern) {
+  if (slot >= STORE_SLOTS)
+    return false;
+  if (!eeprom_is_initialized())
+    return true;
+
+  // The pages of one save fit or fail together, along with everything
+  // already waiting: each may fit on its own while the set does not.
+  // Pending pages of this slot are replaced by this save. A page that adds
+  // no records is not read: changed or not, it costs nothing.
+  uint32_t records = pending_records(slot, false);
+  for (uint8_t page = 0; page < EEPROM_PAGES; page++) {
+    PatternPage next;
+    page_of(pattern, page, &next);
+    uint32_t added = eeprom_page_new_records(slot, page, next);
+    if (added == 0)
+      continue;
+    PatternPage current;
+    peek(slot, page, &current);
+    if (memcmp(&current, &next, sizeof(current)) != 0)
+      records += added;
+  }
+  return eeprom_has_room(records);
+}
+
+void store_service() {
+  EepromJobStatus status = eeprom_service();
+  if (status == EEPROM_JOB_BUSY)
+    return;
+
+  if (status == EEPROM_JOB_DONE) {
+    last_commit_us = time_us_64();
+    committed = true;
+  } else if (status == EEPROM_JOB_FAILED) {
+    // Retry.
+    if (in_flight >= 0)
+      cache[in_flight].dirty = true;
+    if (pending_chain.in_flight)
+      pending_chain.dirty = true;
+  }
+  if (status == EEPROM_JOB_DONE || status == EEPROM_JOB_FAILED) {
+    in_flight = -1;
+    pending_chain.in_flight = false;
+  }
+  if (in_flight >= 0 || pending_chain.in_flight)
+    return;
+
+  if (pending_chain.dirty && !pending_chain.unfit) {
+    if (eeprom_write_chain_async(pending_chain.slots, pending_chain.repeats,
+                                 pending_chain.length)) {
+      pending_chain.dirty = false;
+      pending_chain.in_flight = true;
+    } else {
+      pending_chain.unfit = true;
+    }
+    return;
+  }
+
+  // Write back the least recently used dirty page first: it is the next
+  // one eviction would have to flush in the foreground.
+  int next = -1;
+  for (uint8_t i = 0; i < CACHE_PAGES; i++) {
+    if (cache[i].valid && cache[i].dirty && !cache[i].unfit &&
+        (next < 0 || cache[i].last_use < cache[next].last_use))
+      next = i;
+  }
+  if (next < 0)
+    return;
+
+  // The first I2C operation happens on the next call. No job is running
+  // here, so a refused start means the page does not fit: it stays dirty in
+  // RAM, pinned against eviction, until the slot is saved again.
+  CacheEntry &e = cache[next];
+  if (eeprom_write_page_async(e.slot, e.page, e.data)) {
+    e.dirty = false;
+    in_flight = (int8_t)next;
+  } else {
+    e.unfit = true;
+  }
+}
+
+bool store_save_chain(const uint8_t *slots, const uint8_t *repeats,
+                      uint8_t length) {
+  if (length > EEPROM_CHAIN_LENGTH)
+    return false;
+  bool persist = eeprom_is_initialized();
+  if (persist &&
+      !eeprom_has_room(pending_records(STORE_SLOTS, true) +
+                       eeprom_chain_new_records(length)))
+    return false;
+
+  memcpy(pending_chain.slots, slots, length);
+  memcpy(pending_chain.repeats, repeats, length);
+  pending_chain.length = length;
+  pending_chain.dirty = persist;
+  pending_chain.unfit = false;
+  return true;
+}
+
+uint32_t store_queue_depth() {
+  uint32_t depth = in_flight >= 0 ? 1 : 0;
+  if (pending_chain.dirty || pending_chain.in_flight)
+    depth++;
+  for (const CacheEntry &e : cache) {
+    if (e.valid && e.dirty)
+      depth++;
+  }
+  return depth;
+}
+
+uint32_t store_ms_since_commit() {
+  if (!committed)
+    return UINT32_MAX;
+  return (uint32_t)((time_us_64() - last_commit_us) / 1000);
+}
+
+void store_get_stats(StoreStats *out) { *out = stats; }
+
+bool store_command(int c) {
+  if (c == 's') {
+    print_stats();
+    return true;
+  }
+  if (c == 'S') {
+    stats = {};
+    return true;
+  }
+  return false;
+}
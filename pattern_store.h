@@ -0,0 +1,58 @@
+#pragma once
+
+#include "eeprom.h"
+#include "engine.h"
+#include <cstdint>
+
+// Pattern library: STORE_SLOTS slots of ENGINE_STEPS steps, backed by the
+// EEPROM record store. Only a fixed number of 16-step pages is held in RAM,
+// in an LRU cache, so RAM use does not grow with the library. A miss reads
+// the page from EEPROM, or synthesizes the factory content for a page that
+// was never saved. Saves land in the cache as dirty pages and are written
+// back in the background, one EEPROM job at a time.
+constexpr uint8_t STORE_SLOTS = EEPROM_PATTERN_SLOTS;
+
+struct StoreStats {
+  uint32_t hits;
+  uint32_t misses;
+  uint32_t evictions;    // pages dropped to make room
+  uint32_t sync_flushes; // dirty victims written back in the foreground
+};
+
+// Drop every cached page. Call after eeprom_load_index().
+void store_init();
+
+// Assemble a full pattern from its pages.
+void store_load(uint8_t slot, EnginePattern *pattern);
+
+// Copy a pattern into the cache; only pages that changed become dirty.
+// Returns false, leaving the cache untouched, if the EEPROM has no room for
+// the new pages together with those still waiting to be written (the pattern
+// keeps playing from RAM).
+bool store_save(uint8_t slot, const EnginePattern &pattern);
+
+// True if store_save() would accept `pattern` for `slot` now. Reads the
+// stored pages that the save would add records to.
+bool store_fits(uint8_t slot, const EnginePattern &pattern);
+
+// Queue the song chain for writing, ahead of any page. Returns false if the
+// EEPROM has no room for it along with everything still waiting.
+bool store_save_chain(const uint8_t *slots, const uint8_t *repeats,
+                      uint8_t length);
+
+// Advance the background write-back by at most one short I2C operation.
+// Call once per main-loop iteration.
+void store_service();
+
+// Dirty pages and chain waiting to be written, including the one being
+// written.
+uint32_t store_queue_depth();
+
+// Milliseconds since the last successful EEPROM commit (UINT32_MAX if none).
+uint32_t store_ms_since_commit();
+
+void store_get_stats(StoreStats *stats);
+
+// Console commands: 's' prints the cache counters, 'S' resets them.
+// Returns true if `c` was handled.
+bool store_command(int c);
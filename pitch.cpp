@@ -0,0 +1,134 @@
+#include "pitch.h"
+
+#include "eeprom.h"
+#include <cstdio>
+#include <cstring>
+
+namespace {
+// Fixed point with 8 fractional bits: one semitone is 4096 * 256 / 48 and
+// one cent a hundredth of that.
+constexpr int32_t SEMITONE_Q8 = 4096 * 256 / 48;
+constexpr int32_t CODES_PER_CENT_Q16 = 55924;  // 4096 / 4800 in Q16
+
+struct PitchTable {
+  uint16_t dac[128];
+};
+
+constexpr uint16_t clamp_dac(int32_t code) {
+  return (uint16_t)(code < 0 ? 0 : (code > 0x0FFF ? 0x0FFF : code));
+}
+
+constexpr PitchTable make_nominal_table() {
+  PitchTable table = {};
+  for (int note = 0; note < 128; note++) {
+    int32_t semitones = note - PITCH_MIDI_BASE;
+    if (semitones < 0)
+      semitones = 0;
+    table.dac[note] = clamp_dac((semitones * 4096 + 24) / 48);
+  }
+  return table;
+}
+
+constexpr PitchTable NOMINAL_TABLE = make_nominal_table();
+static_assert(NOMINAL_TABLE.dac[PITCH_MIDI_BASE] == 0, "MIDI 36 is 0 V");
+static_assert(NOMINAL_TABLE.dac[PITCH_MIDI_BASE + 12] == 1024, "1 V/oct");
+
+int8_t octave_offsets[PITCH_OCTAVES] = {0};
+int8_t fine_cents = 0;
+uint8_t console_octave = 0;  // octave the console's +/- adjust
+
+// Rebuild in place. Each entry is a single 16-bit store, so the core1 tick
+// handler reading concurrently sees either the old or the new code.
+void rebuild_table() {
+  for (int note = 0; note < 128; note++) {
+    int32_t semitones = note - PITCH_MIDI_BASE;
+    if (semitones < 0)
+      semitones = 0;
+    uint32_t octave = note / 12;
+    uint32_t step = note % 12;
+    int32_t lo = octave_offsets[octave];
+    int32_t hi = octave + 1 < PITCH_OCTAVES ? octave_offsets[octave + 1] : lo;
+
+    int32_t code_q8 = semitones * SEMITONE_Q8;
+    code_q8 += (lo * (int32_t)(12 - step) + hi * (int32_t)step) * 256 / 12;
+    code_q8 += fine_cents * SEMITONE_Q8 / 100;
+    pitch_table[note] = clamp_dac((code_q8 + 128) >> 8);
+  }
+}
+
+int8_t nudge(int8_t value, int delta) {
+  int next = value + delta;
+  return (int8_t)(next < -128 ? -128 : (next > 127 ? 127 : next));
+}
+
+// The offsets, the fine tune and what they give at the selected octave's C:
+// its code, and the code a quarter tone either side of it.
+void print_calibration() {
+  printf("pitch offsets");
+  for (uint8_t octave = 0; octave < PITCH_OCTAVES; octave++)
+    printf(octave == console_octave ? " [%d]" : " %d",
+           (int)octave_offsets[octave]);
+  uint8_t note = (uint8_t)(console_octave * 12);
+  printf(" fine %d cents; octave %u C: code %u (-50c %u, +50c %u)\n",
+         (int)fine_cents, (unsigned)console_octave, (unsigned)pitch_dac(note),
+         (unsigned)pitch_dac_cents(note, -50),
+         (unsigned)pitch_dac_cents(note, 50));
+}
+} // namespace
+
+uint16_t pitch_table[128];
+
+uint16_t pitch_dac_cents(uint8_t note, int16_t cents) {
+  int32_t delta = ((int32_t)cents * CODES_PER_CENT_Q16 + (1 << 15)) >> 16;
+  return clamp_dac((int32_t)pitch_dac(note) + delta);
+}
+
+void pitch_init() {
+  memcpy(pitch_table, NOMINAL_TABLE.dac, sizeof(pitch_table));
+  if (eeprom_read_calibration(octave_offsets, &fine_cents))
+    rebuild_table();
+}
+
+void pitch_set_octave_offset(uint8_t octave, int8_t codes) {
+  if (octave >= PITCH_OCTAVES)
+    return;
+  octave_offsets[octave] = codes;
+  rebuild_table();
+}
+
+void pitch_set_fine_tune(int8_t cents) {
+  fine_cents = cents;
+  rebuild_table();
+}
+
+void pitch_save_calibration() {
+  eeprom_write_calibration(octave_offsets, fine_cents);
+}
+
+bool pitch_command(int c) {
+  switch (c) {
+  case 'c':
+    break;
+  case 'o':
+    console_octave = (uint8_t)((console_octave + 1) % PITCH_OCTAVES);
+    break;
+  case '+':
+  case '-':
+    pitch_set_octave_offset(console_octave,
+                            nudge(octave_offsets[console_octave],
+                                  c == '+' ? 1 : -1));
+    break;
+  case '>':
+  case '<':
+    pitch_set_fine_tune(nudge(fine_cents, c == '>' ? 1 : -1));
+    break;
+  case 'C':
+    pitch_save_calibration();
+    printf("pitch calibration saved\n");
+    break;
+  default:
+    return false;
+  }
+  print_calibration();
+  return true;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+
+// MIDI note -> MCP4822 code for 1 V/oct: MIDI 36 is 0 V and each semitone is
+// 4096/48 codes (4.096 V over 4 octaves), clamped to the DAC range. The
+// nominal table is generated at compile time; pitch_init() folds per-octave
+// calibration offsets and the fine tune into a RAM copy, so the tick path
+// is a single table load.
+
+constexpr uint8_t PITCH_MIDI_BASE = 36;
+constexpr uint8_t PITCH_OCTAVES = 11;  // MIDI octaves 0..10
+
+extern uint16_t pitch_table[128];
+
+inline uint16_t pitch_dac(uint8_t note) { return pitch_table[note & 0x7F]; }
+
+// Note plus a cents offset, in fixed point. Not table-only, so keep it off
+// the tick path unless the step actually carries a detune.
+uint16_t pitch_dac_cents(uint8_t note, int16_t cents);
+
+// Load the calibration saved in EEPROM (call after the pattern store is
+// loaded) and build the table.
+void pitch_init();
+
+// Calibration: offset in DAC codes at each octave's C (interpolated across
+// the octave), and a global fine tune in cents. Each call rebuilds the
+// table; pitch_save_calibration() persists the current values.
+void pitch_set_octave_offset(uint8_t octave, int8_t codes);
+void pitch_set_fine_tune(int8_t cents);
+void pitch_save_calibration();
+
+// Console commands: 'c' prints the calibration, 'o' selects the next
+// octave, '+'/'-' move its offset by one code, '>'/'<' the fine tune by one
+// cent, 'C' saves. Each prints the result. Returns true if `c` was handled.
+bool pitch_command(int c);
@@ -0,0 +1,108 @@
+#include "profile.h"
+
+#if SEQ_PROFILE
+
+#include "ui.h"
+
+#include "hardware/clocks.h"
+#include <cstdio>
+#include <cstring>
+
+namespace {
+// Four bins per octave: exact below 4 cycles, then ~19% wide up to 2^24.
+constexpr uint32_t NUM_BINS = 96;
+
+struct ProfileZone {
+  uint32_t count;
+  uint64_t total;
+  uint32_t max;
+  uint32_t hist[NUM_BINS];
+};
+
+const char *const ZONE_NAMES[PROF_NUM_ZONES] = {
+    "loop", "service", "buttons", "encoder", "save", "events", "commit",
+};
+
+ProfileZone zones[PROF_NUM_ZONES];
+
+uint32_t bin_of(uint32_t cycles) {
+  if (cycles < 4)
+    return cycles;
+  uint32_t msb = 31 - __builtin_clz(cycles);
+  uint32_t bin = 4 * (msb - 1) + ((cycles >> (msb - 2)) & 3);
+  return bin < NUM_BINS ? bin : NUM_BINS - 1;
+}
+
+uint32_t bin_upper(uint32_t bin) {
+  if (bin < 4)
+    return bin;
+  uint32_t msb = bin / 4 + 1;
+  uint32_t lower = (4 + bin % 4) << (msb - 2);
+  return lower + (1u << (msb - 2)) - 1;
+}
+
+uint32_t percentile_cycles(const ProfileZone &zone, uint32_t per_mille) {
+  uint64_t target = ((uint64_t)zone.count * per_mille + 999) / 1000;
+  uint64_t seen = 0;
+  for (uint32_t bin = 0; bin < NUM_BINS; bin++) {
+    seen += zone.hist[bin];
+    if (seen >= target)
+      return bin_upper(bin) < zone.max ? bin_upper(bin) : zone.max;
+  }
+  return zone.max;
+}
+
+void dump() {
+  uint32_t cycles_per_us = clock_get_hz(clk_sys) / 1000000;
+  if (cycles_per_us == 0)
+    cycles_per_us = 1;
+  printf("zone count total_us avg_us max_us p99_us\n");
+  for (uint32_t i = 0; i < PROF_NUM_ZONES; i++) {
+    const ProfileZone &zone = zones[i];
+    uint64_t avg = zone.count ? zone.total / zone.count : 0;
+    printf("%s %lu %llu %llu %lu %lu\n", ZONE_NAMES[i], (unsigned long)zone.count,
+           (unsigned long long)(zone.total / cycles_per_us),
+           (unsigned long long)(avg / cycles_per_us),
+           (unsigned long)(zone.max / cycles_per_us),
+           (unsigned long)(percentile_cycles(zone, 990) / cycles_per_us));
+  }
+  printf("display bytes/tick last %lu max %lu\n",
+         (unsigned long)ui_flush_bytes_last_tick(),
+         (unsigned long)ui_flush_bytes_max_tick());
+}
+} // namespace
+
+void profile_record(ProfileZoneId zone_id, uint32_t cycles) {
+  ProfileZone &zone = zones[zone_id];
+  zone.count++;
+  zone.total += cycles;
+  if (cycles > zone.max)
+    zone.max = cycles;
+  zone.hist[bin_of(cycles)]++;
+}
+
+void profile_init() {
+  systick_hw->rvr = 0x00FFFFFF;
+  systick_hw->cvr = 0;
+  systick_hw->csr = 0x5; // enable, processor clock, no interrupt
+}
+
+bool profile_command(int c) {
+  if (c == 'p') {
+    dump();
+    return true;
+  }
+  if (c == 'P') {
+    memset(zones, 0, sizeof(zones));
+    return true;
+  }
+  return false;
+}
+
+#else
+
+void profile_init() {}
+
+bool profile_command(int) { return false; }
+
+#endif
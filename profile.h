@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+
+// Main-loop profiler. PROFILE_ZONE(zone) times the enclosing scope with the
+// core's SysTick cycle counter and files the duration under `zone`: count,
+// total, max and a log-scale histogram from which p99 is read. Recording
+// costs a counter read and a few adds. Build with SEQ_PROFILE=0 to compile
+// the zones away. SysTick is 24 bits, so one zone must stay under 2^24
+// cycles (134 ms at 125 MHz); longer scopes alias.
+
+#ifndef SEQ_PROFILE
+#define SEQ_PROFILE 1
+#endif
+
+enum ProfileZoneId : uint8_t {
+  PROF_LOOP,     // one main-loop pass
+  PROF_SERVICE,  // LED, storage and console servicing
+  PROF_BUTTONS,  // button handling and resulting UI updates
+  PROF_ENCODER,  // encoder handling
+  PROF_SAVE,     // save / gate-toggle button handling
+  PROF_EVENTS,   // engine events and per-step UI updates
+  PROF_COMMIT,   // ui_commit()
+  PROF_NUM_ZONES
+};
+
+#if SEQ_PROFILE
+
+#include "hardware/structs/systick.h"
+
+void profile_record(ProfileZoneId zone, uint32_t cycles);
+
+class ProfileScope {
+public:
+  explicit ProfileScope(ProfileZoneId zone)
+      : zone_(zone), start_(systick_hw->cvr) {}
+  ~ProfileScope() {
+    // SysTick counts down.
+    profile_record(zone_, (start_ - systick_hw->cvr) & 0x00FFFFFF);
+  }
+
+private:
+  ProfileZoneId zone_;
+  uint32_t start_;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_ZONE(zone) ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(zone)
+
+#else
+
+#define PROFILE_ZONE(zone) ((void)0)
+
+#endif
+
+// Start the SysTick counter on the calling core (core0).
+void profile_init();
+
+// Console commands: 'p' prints one line per zone (count, total, average,
+// max, p99 in microseconds) and the display bytes flushed per clock tick,
+// 'P' resets all zones. Returns true if `c` was handled.
+bool profile_command(int c);
@@ -1,250 +1,413 @@
 #include "sequencer.h"
 
 #include "eeprom.h"
+#include "pattern_store.h"
 #include "pico/stdlib.h"
-#include <atomic>
 #include <cstring>
 
 namespace {
-constexpr uint8_t NUM_PATTERN_SLOTS = 10;
-constexpr uint8_t PATTERN_SIZE = 16;
+constexpr uint8_t PATTERN_SIZE = ENGINE_STEPS;
 
-uint8_t pattern_storage[NUM_PATTERN_SLOTS][PATTERN_SIZE] = {0};
-uint16_t gate_mask_storage[NUM_PATTERN_SLOTS] = {0};
-uint8_t steps_storage[NUM_PATTERN_SLOTS] = {0};
-bool pattern_dirty[NUM_PATTERN_SLOTS] = {false};
 int8_t pending_pattern_slot = -1;
+uint8_t current_slot = 0;
+
+// Song chain: slots played in order, each for its repeat count, looping
+// back to the first entry. The engine plays one entry while the next is
+// already queued in its back buffer; every switch prefetches the entry
+// after that from the pattern store, a whole pattern ahead of its boundary.
+struct Chain {
+  uint8_t slots[SEQ_CHAIN_LENGTH];
+  uint8_t repeats[SEQ_CHAIN_LENGTH];
+  uint8_t length;
+  bool active;
+  bool entering; // entry 0 is queued, the previous pattern still plays
+  uint8_t index; // entry playing
+};
+
+Chain chain = {};
 
+// core0 view of the sequencer: the current pattern version and a mirror of
+// the play state. Patterns are immutable engine buffers (see engine.h):
+// `pattern` is the newest version core0 published, `queued` the one waiting
+// to be swapped in; core0 holds a reference to both. Edits apply to the
+// selected track, copy-on-write. The play heads come back as engine events.
 struct SequencerState {
   uint32_t bpm;
-  uint32_t steps;
-  uint32_t current_step;
-  std::atomic<bool> playing;
-  uint8_t notes[16];
-  uint16_t gate_mask;
+  bool playing;
+  uint8_t track;
+  uint8_t current_step[ENGINE_TRACKS];
+  const EnginePattern *pattern;
+  const EnginePattern *queued;
 };
 
-static SequencerState state = {
-    120,
-    16,
-    15,
-    false,
-    {48, 50, 52, 54, 55, 57, 59, 60, 62, 64, 66, 67, 69, 71, 72, 74},
-    0xFFFF};
+static SequencerState state = {};
+
+void sanitize_steps(EnginePattern *pattern) {
+  for (uint8_t &steps : pattern->steps) {
+    if (steps < 1 || steps > PATTERN_SIZE)
+      steps = PATTERN_SIZE;
+  }
+}
+
+void rewind_state() {
+  for (uint8_t t = 0; t < ENGINE_TRACKS; t++)
+    state.current_step[t] = (uint8_t)(state.pattern->steps[t] - 1);
+}
+
+void post(EngineCommandType type, uint8_t value = 0,
+          const EnginePattern *pattern = nullptr,
+          const EnginePattern *base = nullptr) {
+  EngineCommand cmd = {};
+  cmd.type = type;
+  cmd.value = value;
+  cmd.pattern = pattern;
+  cmd.base = base;
+  engine_post(cmd);
+}
+
+// Point a core0 reference at `pattern`, releasing the buffer it held.
+void hold(const EnginePattern *&ref, const EnginePattern *pattern) {
+  if (ref)
+    engine_pattern_release(ref);
+  ref = pattern;
+}
+
+// A fresh buffer holding the stored pattern of `slot`.
+EnginePattern *fetch(uint8_t slot) {
+  EnginePattern *pattern = engine_pattern_acquire();
+  store_load(slot, pattern);
+  sanitize_steps(pattern);
+  return pattern;
+}
+
+// Copy-on-write: edits go to a copy of the current version, which
+// commit_edit() then publishes in its place.
+EnginePattern *begin_edit() {
+  EnginePattern *edit = engine_pattern_acquire();
+  *edit = *state.pattern;
+  return edit;
+}
+
+void commit_edit(const EnginePattern *edit) {
+  post(ENGINE_CMD_SET_PATTERN, 0, edit, state.pattern);
+  hold(state.pattern, edit);
+}
+
+void load_slot(uint8_t slot, uint8_t loops) {
+  hold(state.pattern, fetch(slot));
+  current_slot = slot;
+  rewind_state();
+  post(ENGINE_CMD_LOAD_PATTERN, loops, state.pattern);
+}
+
+void queue_slot(uint8_t slot, uint8_t loops) {
+  pending_pattern_slot = slot;
+  hold(state.queued, fetch(slot));
+  post(ENGINE_CMD_QUEUE_PATTERN, loops, state.queued);
+}
+
+void chain_prefetch() {
+  if (chain.length < 2)
+    return;
+  uint8_t next = (uint8_t)((chain.index + 1) % chain.length);
+  queue_slot(chain.slots[next], chain.repeats[next]);
+}
+
+// The engine switched patterns: move to the entry now playing.
+void chain_advance() {
+  if (chain.entering)
+    chain.entering = false;
+  else
+    chain.index = (uint8_t)((chain.index + 1) % chain.length);
+  chain_prefetch();
+}
+
+bool chain_save() {
+  return store_save_chain(chain.slots, chain.repeats, chain.length);
+}
 } // namespace
 
 void seq_init() {
   state.bpm = 120;
-  state.steps = 16;
-  state.current_step = 15;
-  state.playing.store(false);
+  state.playing = false;
+  state.track = 0;
+  post(ENGINE_CMD_STOP);
 }
 
 bool seq_toggle_play() {
-  bool expected = state.playing.load();
-  while (!state.playing.compare_exchange_weak(expected, !expected)) {
-  }
-  return !expected;
+  state.playing = !state.playing;
+  post(state.playing ? ENGINE_CMD_PLAY : ENGINE_CMD_PAUSE);
+  return state.playing;
 }
 
 void seq_stop() {
-  state.playing.store(false);
-  state.current_step = (state.steps > 0) ? (state.steps - 1) : 15;
+  seq_chain_stop();
+  state.playing = false;
+  rewind_state();
+  post(ENGINE_CMD_STOP);
 }
 
-bool seq_is_playing() { return state.playing.load(); }
-
-void seq_advance_step() {
-  uint32_t prev_step = state.current_step;
-  uint32_t steps = state.steps ? state.steps : 16;
-  state.current_step = (state.current_step + 1) % steps;
+bool seq_is_playing() { return state.playing; }
 
-  if (prev_step == (steps - 1) && state.current_step == 0 &&
-      pending_pattern_slot >= 0) {
-    if (pending_pattern_slot < NUM_PATTERN_SLOTS) {
-      memcpy(state.notes, pattern_storage[pending_pattern_slot], PATTERN_SIZE);
-      state.gate_mask = gate_mask_storage[pending_pattern_slot];
-      state.steps = steps_storage[pending_pattern_slot];
-      if (state.steps < 1 || state.steps > 16) {
-        state.steps = 16;
+bool seq_poll_event(EngineEvent *evt) {
+  if (!engine_poll_event(evt))
+    return false;
+  if (evt->type == ENGINE_EVT_STEP) {
+    memcpy(state.current_step, evt->step, sizeof(state.current_step));
+    if (evt->pattern_switched) {
+      // Follow the engine into the queued pattern. Edits posted before this
+      // event were derived from the old one and the engine dropped them.
+      // Republishing the current version also resyncs a switch core0 had
+      // already cancelled.
+      if (state.queued) {
+        hold(state.pattern, state.queued);
+        state.queued = nullptr;
+        current_slot = (uint8_t)pending_pattern_slot;
       }
+      pending_pattern_slot = -1;
+      post(ENGINE_CMD_SET_PATTERN, 0, state.pattern);
+      if (chain.active)
+        chain_advance();
     }
-    pending_pattern_slot = -1;
   }
+  return true;
+}
+
+uint32_t seq_current_step() { return state.current_step[state.track]; }
+
+void seq_select_track(uint8_t track) {
+  if (track < ENGINE_TRACKS)
+    state.track = track;
 }
 
-uint32_t seq_current_step() { return state.current_step; }
+uint8_t seq_get_track() { return state.track; }
 
 uint32_t seq_get_bpm() { return state.bpm; }
 
 void seq_set_bpm(uint32_t new_bpm) { state.bpm = new_bpm ? new_bpm : 120; }
 
-uint32_t seq_get_steps() { return state.steps; }
+uint32_t seq_get_steps() { return state.pattern->steps[state.track]; }
 
 void seq_set_steps(uint32_t steps) {
   if (steps < 1)
     steps = 1;
-  if (steps > 16)
-    steps = 16;
-  state.steps = steps;
+  if (steps > ENGINE_STEPS)
+    steps = ENGINE_STEPS;
+  EnginePattern *edit = begin_edit();
+  edit->steps[state.track] = (uint8_t)steps;
+  commit_edit(edit);
 }
 
 uint8_t seq_get_note(uint32_t step) {
-  if (step >= 16)
+  if (step >= ENGINE_STEPS)
     step = 0;
-  return state.notes[step];
+  return state.pattern->notes[state.track][step];
 }
 
 void seq_set_note(uint32_t step, uint8_t note) {
-  if (step >= 16)
+  if (step >= ENGINE_STEPS)
     return;
   if (note > 127)
     note = 127;
-  state.notes[step] = note;
+  EnginePattern *edit = begin_edit();
+  edit->notes[state.track][step] = note;
+  commit_edit(edit);
+}
+
+uint16_t seq_get_cv_b(uint32_t step) {
+  if (step >= ENGINE_STEPS)
+    step = 0;
+  return state.pattern->cv_b[state.track][step];
+}
+
+void seq_set_cv_b(uint32_t step, uint16_t value) {
+  if (step >= ENGINE_STEPS)
+    return;
+  if (value > 4095)
+    value = 4095;
+  EnginePattern *edit = begin_edit();
+  edit->cv_b[state.track][step] = value;
+  commit_edit(edit);
 }
 
 bool seq_get_gate_enabled(uint32_t step) {
-  if (step >= 16)
+  if (step >= ENGINE_STEPS)
     return false;
-  return (state.gate_mask & (1 << step)) != 0;
+  return (state.pattern->gate_mask[state.track] >> step) & 1;
 }
 
 void seq_toggle_gate(uint32_t step) {
-  if (step >= 16)
+  if (step >= ENGINE_STEPS)
+    return;
+  EnginePattern *edit = begin_edit();
+  edit->gate_mask[state.track] ^= 1ull << step;
+  commit_edit(edit);
+}
+
+uint8_t seq_get_gate_length(uint32_t step) {
+  if (step >= ENGINE_STEPS)
+    step = 0;
+  uint8_t percent = state.pattern->gate_len[state.track][step];
+  return percent ? percent : ENGINE_GATE_DEFAULT;
+}
+
+void seq_set_gate_length(uint32_t step, uint8_t percent) {
+  if (step >= ENGINE_STEPS)
     return;
-  state.gate_mask ^= (1 << step);
+  if (percent < 1)
+    percent = 1;
+  if (percent > ENGINE_GATE_MAX)
+    percent = ENGINE_GATE_MAX;
+  EnginePattern *edit = begin_edit();
+  edit->gate_len[state.track][step] = percent;
+  commit_edit(edit);
+}
+
+uint8_t seq_get_ratchets(uint32_t step) {
+  if (step >= ENGINE_STEPS)
+    step = 0;
+  uint8_t count = state.pattern->ratchets[state.track][step];
+  return count ? count : 1;
+}
+
+void seq_set_ratchets(uint32_t step, uint8_t count) {
+  if (step >= ENGINE_STEPS)
+    return;
+  if (count < 1)
+    count = 1;
+  if (count > ENGINE_RATCHETS_MAX)
+    count = ENGINE_RATCHETS_MAX;
+  // A single gate is stored as the default, as it reads back from EEPROM.
+  EnginePattern *edit = begin_edit();
+  edit->ratchets[state.track][step] = count > 1 ? count : 0;
+  commit_edit(edit);
+}
+
+int8_t seq_get_offset(uint32_t step) {
+  if (step >= ENGINE_STEPS)
+    step = 0;
+  return state.pattern->offset[state.track][step];
+}
+
+void seq_set_offset(uint32_t step, int8_t percent) {
+  if (step >= ENGINE_STEPS)
+    return;
+  if (percent < -ENGINE_OFFSET_MAX)
+    percent = -ENGINE_OFFSET_MAX;
+  if (percent > ENGINE_OFFSET_MAX)
+    percent = ENGINE_OFFSET_MAX;
+  EnginePattern *edit = begin_edit();
+  edit->offset[state.track][step] = percent;
+  commit_edit(edit);
 }
 
 void seq_init_flash() {
   eeprom_init();
+  eeprom_load_index();
+  store_init();
+  if (!eeprom_read_chain(chain.slots, chain.repeats, &chain.length))
+    chain.length = 0;
+  // Only now can slot 0 be read back from the EEPROM.
+  load_slot(0, 1);
+}
 
-  if (eeprom_is_initialized() && eeprom_has_valid_data()) {
-    for (int i = 0; i < NUM_PATTERN_SLOTS; ++i) {
-      eeprom_read_pattern(i, pattern_storage[i], &gate_mask_storage[i],
-                          &steps_storage[i]);
-      if (steps_storage[i] < 1 || steps_storage[i] > 16) {
-        steps_storage[i] = 16;
-      }
-    }
-  } else {
-    // Pattern 0: C Major Scale (C3 to C4)
-    uint8_t pattern0[16] = {48, 50, 52, 53, 55, 57, 59, 60,
-                            59, 57, 55, 53, 52, 50, 48, 60};
-
-    // Pattern 1: Minor Arpeggio (Am)
-    uint8_t pattern1[16] = {57, 60, 64, 69, 64, 60, 57, 69,
-                            57, 60, 64, 69, 72, 69, 64, 60};
-
-    // Pattern 2: Pentatonic Sequence
-    uint8_t pattern2[16] = {60, 62, 65, 67, 70, 72, 70, 67,
-                            65, 62, 60, 67, 65, 70, 62, 72};
-
-    // Pattern 3: Bass Line (Techno Style)
-    uint8_t pattern3[16] = {36, 48, 36, 43, 36, 48, 40, 36,
-                            38, 50, 38, 45, 38, 50, 43, 38};
-
-    // Pattern 4: Octave Jump Pattern
-    uint8_t pattern4[16] = {48, 60, 50, 62, 52, 64, 53, 65,
-                            55, 67, 57, 69, 59, 71, 60, 72};
-
-    // Pattern 5: Chord Progression (C-F-G-Am)
-    uint8_t pattern5[16] = {48, 52, 55, 60, 53, 57, 60, 65,
-                            55, 59, 62, 67, 57, 60, 64, 69};
-
-    // Pattern 6: Ambient Pad
-    uint8_t pattern6[16] = {60, 64, 67, 72, 67, 64, 60, 72,
-                            62, 65, 69, 74, 69, 65, 62, 74};
-
-    // Pattern 7: Chromatic Walk
-    uint8_t pattern7[16] = {60, 61, 62, 63, 64, 65, 66, 67,
-                            68, 69, 70, 71, 72, 71, 70, 69};
-
-    // Pattern 8: Melodic Sequence (Uplifting)
-    uint8_t pattern8[16] = {60, 64, 67, 72, 64, 67, 72, 76,
-                            67, 72, 76, 79, 72, 76, 79, 84};
-
-    // Pattern 9: Rhythmic Pattern (Hi-Low)
-    uint8_t pattern9[16] = {72, 48, 72, 60, 74, 50, 74, 62,
-                            76, 52, 76, 64, 77, 53, 77, 65};
-
-    memcpy(pattern_storage[0], pattern0, PATTERN_SIZE);
-    memcpy(pattern_storage[1], pattern1, PATTERN_SIZE);
-    memcpy(pattern_storage[2], pattern2, PATTERN_SIZE);
-    memcpy(pattern_storage[3], pattern3, PATTERN_SIZE);
-    memcpy(pattern_storage[4], pattern4, PATTERN_SIZE);
-    memcpy(pattern_storage[5], pattern5, PATTERN_SIZE);
-    memcpy(pattern_storage[6], pattern6, PATTERN_SIZE);
-    memcpy(pattern_storage[7], pattern7, PATTERN_SIZE);
-    memcpy(pattern_storage[8], pattern8, PATTERN_SIZE);
-    memcpy(pattern_storage[9], pattern9, PATTERN_SIZE);
-
-    for (int i = 0; i < NUM_PATTERN_SLOTS; ++i) {
-      gate_mask_storage[i] = 0xFFFF;
-      steps_storage[i] = 16;
-    }
-
-    if (eeprom_is_initialized()) {
-      for (int i = 0; i < NUM_PATTERN_SLOTS; ++i) {
-        eeprom_write_pattern(i, pattern_storage[i], gate_mask_storage[i],
-                             steps_storage[i]);
-      }
-      eeprom_mark_valid();
-    }
-  }
+bool seq_save_pattern(uint8_t slot) {
+  if (slot >= STORE_SLOTS)
+    return false;
+  return store_save(slot, *state.pattern);
 }
 
-void seq_save_pattern_ram_only(uint8_t slot) {
-  if (slot >= NUM_PATTERN_SLOTS)
+bool seq_can_save(uint8_t slot) { return store_fits(slot, *state.pattern); }
+
+void seq_storage_service() { store_service(); }
+
+uint32_t seq_storage_queue_depth() { return store_queue_depth(); }
+
+uint32_t seq_storage_ms_since_commit() { return store_ms_since_commit(); }
+
+void seq_load_pattern(uint8_t slot) {
+  if (slot >= STORE_SLOTS)
     return;
-  memcpy(pattern_storage[slot], state.notes, PATTERN_SIZE);
-  gate_mask_storage[slot] = state.gate_mask;
-  steps_storage[slot] = (uint8_t)state.steps;
-  pattern_dirty[slot] = true;
+  seq_chain_stop();
+  load_slot(slot, 1);
 }
 
-void seq_flush_all_patterns_to_eeprom() {
-  if (!eeprom_is_initialized())
+void seq_queue_pattern(uint8_t slot) {
+  if (slot >= STORE_SLOTS)
     return;
-  bool any_written = false;
-  for (int i = 0; i < NUM_PATTERN_SLOTS; i++) {
-    if (pattern_dirty[i]) {
-      eeprom_write_pattern(i, pattern_storage[i], gate_mask_storage[i],
-                           steps_storage[i]);
-      pattern_dirty[i] = false;
-      any_written = true;
-    }
-  }
-  if (any_written && !eeprom_has_valid_data()) {
-    eeprom_mark_valid();
-  }
+  seq_chain_stop();
+  queue_slot(slot, 1);
 }
 
-bool seq_has_dirty_patterns() {
-  for (int i = 0; i < NUM_PATTERN_SLOTS; i++) {
-    if (pattern_dirty[i]) {
-      return true;
-    }
+int8_t seq_get_pending_pattern() { return pending_pattern_slot; }
+
+uint8_t seq_get_slot() { return current_slot; }
+
+uint8_t seq_chain_length() { return chain.length; }
+
+bool seq_chain_entry(uint8_t index, uint8_t *slot, uint8_t *repeats) {
+  if (index >= chain.length)
+    return false;
+  *slot = chain.slots[index];
+  *repeats = chain.repeats[index];
+  return true;
+}
+
+bool seq_chain_append(uint8_t slot) {
+  if (slot >= STORE_SLOTS)
+    return false;
+  Chain before = chain;
+  uint8_t last = chain.length - 1;
+  if (chain.length > 0 && chain.slots[last] == slot) {
+    if (chain.repeats[last] >= SEQ_CHAIN_MAX_REPEATS)
+      return false;
+    chain.repeats[last]++;
+  } else {
+    if (chain.length >= SEQ_CHAIN_LENGTH)
+      return false;
+    chain.slots[chain.length] = slot;
+    chain.repeats[chain.length] = 1;
+    chain.length++;
   }
+  if (chain_save())
+    return true;
+  chain = before;
   return false;
 }
 
-void seq_load_pattern(uint8_t slot) {
-  if (slot >= NUM_PATTERN_SLOTS)
-    return;
+bool seq_chain_clear() {
+  seq_chain_stop();
+  chain.length = 0;
+  return chain_save();
+}
 
-  memcpy(state.notes, pattern_storage[slot], PATTERN_SIZE);
-  state.gate_mask = gate_mask_storage[slot];
-  state.steps = steps_storage[slot];
-  if (state.steps < 1 || state.steps > 16) {
-    state.steps = 16;
+bool seq_chain_start() {
+  if (chain.length == 0)
+    return false;
+  chain.active = true;
+  chain.index = 0;
+  if (state.playing) {
+    // Enter at the loop boundary, like a queued pattern.
+    chain.entering = true;
+    queue_slot(chain.slots[0], chain.repeats[0]);
+  } else {
+    chain.entering = false;
+    pending_pattern_slot = -1;
+    load_slot(chain.slots[0], chain.repeats[0]);
+    chain_prefetch();
   }
-  state.current_step = (state.steps > 0) ? (state.steps - 1) : 15;
+  return true;
 }
 
-void seq_queue_pattern(uint8_t slot) {
-  if (slot >= NUM_PATTERN_SLOTS)
+void seq_chain_stop() {
+  if (!chain.active)
     return;
-  pending_pattern_slot = slot;
+  chain.active = false;
+  pending_pattern_slot = -1;
+  hold(state.queued, nullptr);
+  post(ENGINE_CMD_UNQUEUE_PATTERN);
 }
 
-int8_t seq_get_pending_pattern() { return pending_pattern_slot; }
+bool seq_chain_active() { return chain.active; }
+
+uint8_t seq_chain_position() { return chain.index; }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "eeprom.h"
+#include "engine.h"
 #include <cstdint>
 
 void seq_init();
@@ -9,10 +11,16 @@ bool seq_toggle_play();
 void seq_stop();
 bool seq_is_playing();
 
-// Step operations
-void seq_advance_step();
+// Drain one event from the core1 engine, updating the play position and
+// following pattern switches. Returns false when no event is pending.
+bool seq_poll_event(EngineEvent *evt);
 uint32_t seq_current_step();
 
+// Track that the step, note, gate and length operations below apply to
+// (0..ENGINE_TRACKS-1). Track 0 drives the CV outputs.
+void seq_select_track(uint8_t track);
+uint8_t seq_get_track();
+
 // Tempo helpers
 uint32_t seq_get_bpm();
 void seq_set_bpm(uint32_t bpm);
@@ -25,14 +33,74 @@ void seq_set_steps(uint32_t steps);
 uint8_t seq_get_note(uint32_t step);
 void seq_set_note(uint32_t step, uint8_t note);
 
+// Second CV lane (MCP4822 channel B), raw 12-bit DAC code 0-4095 per step.
+// Written in the same SPI burst as the pitch CV.
+uint16_t seq_get_cv_b(uint32_t step);
+void seq_set_cv_b(uint32_t step, uint16_t value);
+
 // Gate enable/disable operations
 bool seq_get_gate_enabled(uint32_t step);
 void seq_toggle_gate(uint32_t step);
 
-void seq_save_pattern_ram_only(uint8_t slot);
-void seq_flush_all_patterns_to_eeprom();
-bool seq_has_dirty_patterns();
+// Step timing (see EnginePattern): gate length in percent of the step, or
+// of each ratchet (1-100), ratchets per step (1-4) and the offset of the
+// step in percent (-50..+50). Values are clamped to range.
+uint8_t seq_get_gate_length(uint32_t step);
+void seq_set_gate_length(uint32_t step, uint8_t percent);
+uint8_t seq_get_ratchets(uint32_t step);
+void seq_set_ratchets(uint32_t step, uint8_t count);
+int8_t seq_get_offset(uint32_t step);
+void seq_set_offset(uint32_t step, int8_t percent);
+
+// Copy the edited pattern into `slot` (0..STORE_SLOTS-1) and queue its
+// changed pages for background EEPROM persistence (works while playing).
+// Returns false if the EEPROM has no room left for it.
+bool seq_save_pattern(uint8_t slot);
+
+// True if seq_save_pattern(slot) would succeed now.
+bool seq_can_save(uint8_t slot);
+
+// Advance the background storage queue by at most one short I2C operation.
+// Call once per main-loop iteration.
+void seq_storage_service();
+
+// Pages waiting to be persisted, including the one being written.
+uint32_t seq_storage_queue_depth();
+
+// Milliseconds since the last successful EEPROM commit (UINT32_MAX if none).
+uint32_t seq_storage_ms_since_commit();
+
+// Load or queue a single slot. Both leave song chain mode.
 void seq_load_pattern(uint8_t slot);
 void seq_queue_pattern(uint8_t slot);
 int8_t seq_get_pending_pattern();
+
+// Bring up the EEPROM and the pattern store, then load slot 0. Call once,
+// after seq_init().
 void seq_init_flash();
+
+// Slot of the pattern being played and edited.
+uint8_t seq_get_slot();
+
+// Song chain: an ordered list of slots, each played `repeats` times before
+// the next, looping at the end. The next entry is prefetched into the
+// engine's back buffer as soon as the previous switch happened, so the
+// switch itself is a pointer swap on core1. Edits to the chain are saved
+// to EEPROM right away (the functions return false if that failed).
+constexpr uint8_t SEQ_CHAIN_LENGTH = EEPROM_CHAIN_LENGTH;
+constexpr uint8_t SEQ_CHAIN_MAX_REPEATS = 16;
+
+uint8_t seq_chain_length();
+bool seq_chain_entry(uint8_t index, uint8_t *slot, uint8_t *repeats);
+
+// Append `slot`, or add a repeat if it is already the last entry.
+bool seq_chain_append(uint8_t slot);
+bool seq_chain_clear();
+
+// Start the chain from its first entry: right away when stopped, at the
+// loop boundary while playing. seq_stop(), seq_load_pattern() and
+// seq_queue_pattern() stop it.
+bool seq_chain_start();
+void seq_chain_stop();
+bool seq_chain_active();
+uint8_t seq_chain_position();
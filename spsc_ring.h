@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Wait-free single-producer/single-consumer ring buffer for passing messages
+// between the two cores. The producer only writes head_ and the consumer only
+// writes tail_, so plain 32-bit atomic loads and stores with acquire/release
+// ordering are enough: no read-modify-write, which the Cortex-M0+ lacks.
+// N must be a power of two; the indices run freely and wrap at 2^32.
+template <typename T, uint32_t N> class SpscRing {
+  static_assert(N > 0 && (N & (N - 1)) == 0, "N must be a power of two");
+
+public:
+  // Producer side. Returns false if the ring is full.
+  bool push(const T &item) {
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) == N)
+      return false;
+    items_[head & (N - 1)] = item;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side. Returns false if the ring is empty.
+  bool pop(T *item) {
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    if (head_.load(std::memory_order_acquire) == tail)
+      return false;
+    *item = items_[tail & (N - 1)];
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool empty() const {
+    return head_.load(std::memory_order_acquire) ==
+           tail_.load(std::memory_order_acquire);
+  }
+
+private:
+  std::atomic<uint32_t> head_{0};
+  std::atomic<uint32_t> tail_{0};
+  T items_[N];
+};
@@ -0,0 +1,63 @@
+// 24 hours of tick deadlines at several tempos, including fractional ones.
+// The 32.32 phase accumulator may only be off the ideal grid by the interval's
+// rounding to 2^-32 us, once per tick: it must never lose the fraction it
+// truncates, so over a whole day it drifts by less than a microsecond.
+
+#include "host.h"
+
+// The accumulator lives in clock.cpp's anonymous namespace.
+#include "../clock.cpp"
+
+uint16_t pitch_table[128];
+void dac_init() {}
+void dac_write_both(uint16_t, uint16_t) {}
+
+namespace {
+constexpr uint64_t DAY_US = 24ull * 3600 * 1000 * 1000;
+
+// Ideal 16th-note deadline n is n * US_PER_16TH_CENTI / centi_bpm.
+constexpr uint64_t US_PER_16TH_CENTI = 1'500'000'000ULL;
+
+void run_day(uint32_t centi_bpm) {
+  set_tempo(centi_bpm);
+  next_tick_us = 0;
+  next_tick_frac = 0;
+
+  uint64_t ticks = 0;
+  __int128 worst = 0;
+  while (next_tick_us < DAY_US) {
+    advance_deadline();
+    ticks++;
+    // Deadline with its fraction minus the ideal one, in 2^-32 us scaled by
+    // centi_bpm to stay in integers. Rounding the interval to the nearest
+    // 2^-32 us costs at most half of one per tick.
+    __int128 deadline = ((__int128)next_tick_us << 32) | next_tick_frac;
+    __int128 error = deadline * centi_bpm -
+                     ((__int128)ticks * US_PER_16TH_CENTI << 32);
+    __int128 magnitude = error < 0 ? -error : error;
+    CHECK(magnitude * 2 <= (__int128)ticks * centi_bpm);
+    if (magnitude > worst)
+      worst = magnitude;
+  }
+  double worst_us = (double)worst / centi_bpm / 4294967296.0;
+  CHECK(worst_us < 1.0);
+
+  // What the old integer interval would have drifted by over the day.
+  uint64_t truncated = US_PER_16TH_CENTI / centi_bpm;
+  double legacy_ms =
+      (ticks * (double)US_PER_16TH_CENTI / centi_bpm - ticks * truncated) /
+      1000.0;
+  printf("%3u.%02u BPM: %llu ticks, drift %.6f us (integer interval: "
+         "%.1f ms)\n",
+         centi_bpm / 100, centi_bpm % 100, (unsigned long long)ticks,
+         worst_us, legacy_ms);
+}
+} // namespace
+
+int main() {
+  const uint32_t tempos[] = {2000, 10700, 11400, 12000, 12025,
+                             13300, 13700, 17417, 30000};
+  for (uint32_t centi_bpm : tempos)
+    run_day(centi_bpm);
+  return 0;
+}
@@ -0,0 +1,149 @@
+// Per-tick cost of engine_tick() over the struct-of-arrays pattern, built
+// once per track count (SEQ_ENGINE_TRACKS), against the same evaluation over
+// an array-of-structs layout with one struct per step. Both must produce the
+// same steps; the cost of a tick should grow by a few nanoseconds per track,
+// not jump.
+
+#include "host.h"
+
+// Play heads and timing helpers are in engine.cpp's anonymous namespace.
+#include "../engine.cpp"
+
+#include <chrono>
+
+namespace {
+constexpr uint32_t TICKS = 200000;
+constexpr int RUNS = 5;
+
+// The layout the engine does not use: every field of a step together.
+struct AosStep {
+  uint8_t note;
+  uint16_t cv_b;
+  uint8_t gate_len;
+  uint8_t ratchets;
+  int8_t offset;
+  bool gate;
+};
+struct AosTrack {
+  AosStep steps[ENGINE_STEPS];
+  uint8_t length;
+};
+AosTrack aos[ENGINE_TRACKS];
+uint8_t aos_position[ENGINE_TRACKS];
+
+// engine_tick() step for step, only reading the other layout: advance
+// every play head, then evaluate every track and fill the STEP event.
+void aos_tick(uint64_t time_us, SeqStep *out, EngineEvent *evt) {
+  for (uint8_t t = 0; t < ENGINE_TRACKS; t++) {
+    uint8_t length = aos[t].length;
+    if (length < 1 || length > ENGINE_STEPS)
+      length = ENGINE_STEPS;
+    uint32_t next = aos_position[t] + 1u;
+    aos_position[t] = (uint8_t)(next >= length ? 0 : next);
+  }
+
+  *evt = {};
+  evt->time_us = time_us;
+  evt->type = ENGINE_EVT_STEP;
+  uint8_t gates = 0;
+  for (uint8_t t = 0; t < ENGINE_TRACKS; t++) {
+    uint8_t step = aos_position[t];
+    const AosStep &s = aos[t].steps[step];
+    out->note[t] = s.note;
+    out->cv_b[t] = s.cv_b;
+    out->gate_len[t] = gate_length(s.gate_len);
+    out->ratchets[t] = ratchet_count(s.ratchets);
+    out->offset[t] = step_offset(s.offset);
+    gates |= (uint8_t)(s.gate << t);
+    evt->step[t] = step;
+  }
+  out->gates = gates;
+}
+
+// Every track a different length, so the play heads drift apart.
+void fill(EnginePattern *pattern) {
+  uint32_t seed = 12345;
+  auto next = [&seed] { return seed = seed * 1103515245u + 12345u; };
+  for (uint8_t t = 0; t < ENGINE_TRACKS; t++) {
+    pattern->steps[t] = (uint8_t)(ENGINE_STEPS - 7 * t % ENGINE_STEPS);
+    pattern->gate_mask[t] = ((uint64_t)next() << 32) | next();
+    aos[t].length = pattern->steps[t];
+    aos_position[t] = (uint8_t)(aos[t].length - 1);
+    for (uint8_t s = 0; s < ENGINE_STEPS; s++) {
+      pattern->notes[t][s] = (uint8_t)(36 + next() % 48);
+      pattern->cv_b[t][s] = (uint16_t)(next() & 0xFFF);
+      pattern->gate_len[t][s] = (uint8_t)(next() % 101);
+      pattern->ratchets[t][s] = (uint8_t)(next() % 5);
+      pattern->offset[t][s] = (int8_t)(next() % 101 - 50);
+      aos[t].steps[s] = {pattern->notes[t][s],
+                         pattern->cv_b[t][s],
+                         pattern->gate_len[t][s],
+                         pattern->ratchets[t][s],
+                         pattern->offset[t][s],
+                         (bool)((pattern->gate_mask[t] >> s) & 1u)};
+    }
+  }
+}
+
+bool same(const SeqStep &a, const SeqStep &b) {
+  for (uint8_t t = 0; t < ENGINE_TRACKS; t++) {
+    if (a.note[t] != b.note[t] || a.cv_b[t] != b.cv_b[t] ||
+        a.gate_len[t] != b.gate_len[t] || a.ratchets[t] != b.ratchets[t] ||
+        a.offset[t] != b.offset[t])
+      return false;
+  }
+  return a.gates == b.gates;
+}
+
+// Best nanoseconds per tick over a few runs.
+template <typename Tick> double time_ticks(Tick tick) {
+  double best = 0;
+  for (int run = 0; run < RUNS; run++) {
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < TICKS; i++)
+      tick(i);
+    std::chrono::duration<double, std::nano> elapsed =
+        std::chrono::steady_clock::now() - start;
+    double per_tick = elapsed.count() / TICKS;
+    if (run == 0 || per_tick < best)
+      best = per_tick;
+  }
+  return best;
+}
+
+volatile uint8_t sink;
+} // namespace
+
+int main() {
+  EnginePattern *pattern = engine_pattern_acquire();
+  fill(pattern);
+  EngineCommand cmd = {};
+  cmd.type = ENGINE_CMD_LOAD_PATTERN;
+  cmd.pattern = pattern;
+  engine_apply(cmd);
+  cmd = {};
+  cmd.type = ENGINE_CMD_PLAY;
+  engine_apply(cmd);
+
+  // Both layouts walk the same steps: a full cycle of every length.
+  SeqStep soa_step, aos_step;
+  EngineEvent evt, aos_evt;
+  for (uint32_t i = 0; i < 64 * 64; i++) {
+    CHECK(engine_tick(i, &soa_step, &evt));
+    aos_tick(i, &aos_step, &aos_evt);
+    CHECK(same(soa_step, aos_step));
+  }
+
+  double soa = time_ticks([&](uint32_t i) {
+    engine_tick(i, &soa_step, &evt);
+    sink = soa_step.gates;
+  });
+  double aos_ns = time_ticks([&](uint32_t i) {
+    aos_tick(i, &aos_step, &aos_evt);
+    sink = aos_step.gates;
+  });
+  printf("%u track%s: %.1f ns/tick SoA (%.1f ns/track), %.1f ns/tick AoS\n",
+         (unsigned)ENGINE_TRACKS, ENGINE_TRACKS > 1 ? "s" : "", soa,
+         soa / ENGINE_TRACKS, aos_ns);
+  return 0;
+}
@@ -0,0 +1,89 @@
+// Scaled text: the pre-scaled glyph blit in draw_scaled_char() against the
+// per-pixel path it replaced. The blit must produce the same framebuffer for
+// every glyph, scale and position; then both are timed on a BPM line.
+
+#include "host.h"
+
+// The framebuffer and the glyph tables are file-static in ui.cpp.
+#include "../ui.cpp"
+
+#include <chrono>
+
+namespace {
+// The 2x/3x drawing before the scaled tables: one set_pixel() per pixel.
+void draw_scaled_char_per_pixel(int x0, int y0, char c, int scale) {
+  const uint8_t *glyph = font5x7[char_to_font_index(c)];
+  for (int col = 0; col < 5; ++col) {
+    for (int row = 0; row < 7; ++row) {
+      if (!((glyph[col] >> row) & 1u))
+        continue;
+      int px = x0 + col * scale;
+      int py = y0 + row * scale;
+      for (int dx = 0; dx < scale; ++dx) {
+        for (int dy = 0; dy < scale; ++dy)
+          set_pixel(px + dx, py + dy);
+      }
+    }
+  }
+}
+
+const char GLYPHS[] = " 0123456789:ABCDEFGHIJKLMNOPQRSTUVWXYZ#/><-+%";
+
+void check_identical() {
+  static uint8_t expected[sizeof(fb)];
+  uint32_t cases = 0;
+  for (const char *c = GLYPHS; *c; c++) {
+    for (int scale = 2; scale <= 3; scale++) {
+      for (int y = 0; y < 64; y++) {
+        for (int x = -5 * scale; x < 128; x += 3) {
+          memset(fb, 0, sizeof(fb));
+          draw_scaled_char_per_pixel(x, y, *c, scale);
+          memcpy(expected, fb, sizeof(fb));
+          memset(fb, 0, sizeof(fb));
+          draw_scaled_char(x, y, *c, scale);
+          CHECK(memcmp(expected, fb, sizeof(fb)) == 0);
+          cases++;
+        }
+      }
+    }
+  }
+  printf("blit matches per-pixel drawing in %u cases\n", cases);
+}
+
+// Nanoseconds per character drawing `text` at `scale`, as ui_show_bpm()
+// does on every tick. Best of a few runs, to keep scheduler noise out.
+template <typename Draw>
+double time_text(Draw draw, const char *text, int scale) {
+  constexpr int RUNS = 5;
+  constexpr int ROUNDS = 10000;
+  size_t len = strlen(text);
+  double best = 0;
+  for (int run = 0; run < RUNS; run++) {
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < ROUNDS; round++) {
+      memset(fb, 0, sizeof(fb));
+      int x = 0;
+      for (size_t i = 0; i < len; i++, x += 6 * scale)
+        draw(x, 8 + (round & 7), text[i], scale);
+    }
+    std::chrono::duration<double, std::nano> elapsed =
+        std::chrono::steady_clock::now() - start;
+    double per_char = elapsed.count() / (ROUNDS * len);
+    if (run == 0 || per_char < best)
+      best = per_char;
+  }
+  return best;
+}
+} // namespace
+
+int main() {
+  check_identical();
+  const char *line[] = {nullptr, nullptr, "120 BPM", "P:12"};
+  for (int scale = 2; scale <= 3; scale++) {
+    double before = time_text(draw_scaled_char_per_pixel, line[scale], scale);
+    double after = time_text(draw_scaled_char, line[scale], scale);
+    printf("%dx: %.0f ns/char blit vs %.0f ns/char per-pixel (%.1fx)\n",
+           scale, after, before, before / after);
+  }
+  return 0;
+}
@@ -0,0 +1,58 @@
+#include "host.h"
+
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#include "hardware/i2c.h"
+#include "hardware/timer.h"
+#include "pico/multicore.h"
+#include "pico/stdlib.h"
+
+uint64_t host_time_us = 0;
+
+uint64_t time_us_64() { return host_time_us; }
+uint32_t time_us_32() { return (uint32_t)host_time_us; }
+void sleep_ms(uint32_t ms) { host_time_us += ms * 1000ull; }
+void sleep_us(uint64_t us) { host_time_us += us; }
+
+uint32_t save_and_disable_interrupts() { return 0; }
+void restore_interrupts(uint32_t) {}
+
+void multicore_launch_core1(void (*)()) {}
+
+// The alarm never fires on its own: tests drive the callbacks they need.
+int hardware_alarm_claim_unused(bool) { return 0; }
+void hardware_alarm_set_callback(uint, hardware_alarm_callback_t) {}
+bool hardware_alarm_set_target(uint, absolute_time_t t) {
+  return t <= host_time_us;
+}
+void hardware_alarm_force_irq(uint) {}
+
+void gpio_init(uint) {}
+void gpio_set_dir(uint, bool) {}
+void gpio_put(uint, bool) {}
+void gpio_set_mask(uint32_t) {}
+void gpio_clr_mask(uint32_t) {}
+void gpio_set_function(uint, enum gpio_function) {}
+void gpio_pull_up(uint) {}
+
+i2c_inst_t i2c0_inst, i2c1_inst;
+uint i2c_init(i2c_inst_t *, uint baudrate) { return baudrate; }
+int i2c_write_blocking(i2c_inst_t *, uint8_t, const uint8_t *, size_t, bool) {
+  return PICO_ERROR_GENERIC;
+}
+int i2c_read_blocking(i2c_inst_t *, uint8_t, uint8_t *, size_t, bool) {
+  return PICO_ERROR_GENERIC;
+}
+
+int dma_claim_unused_channel(bool) { return 0; }
+dma_channel_config dma_channel_get_default_config(uint) { return {}; }
+void channel_config_set_transfer_data_size(dma_channel_config *,
+                                           enum dma_channel_transfer_size) {}
+void channel_config_set_read_increment(dma_channel_config *, bool) {}
+void channel_config_set_write_increment(dma_channel_config *, bool) {}
+void channel_config_set_dreq(dma_channel_config *, uint) {}
+void dma_channel_configure(uint, const dma_channel_config *, volatile void *,
+                           const volatile void *, uint, bool) {}
+void dma_channel_transfer_from_buffer_now(uint, const volatile void *,
+                                          uint32_t) {}
+bool dma_channel_is_busy(uint) { return false; }
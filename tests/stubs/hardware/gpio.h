@@ -0,0 +1,16 @@
+#pragma once
+
+#include "pico/stdlib.h"
+
+#define GPIO_OUT 1
+#define GPIO_IN 0
+
+enum gpio_function { GPIO_FUNC_SPI, GPIO_FUNC_I2C, GPIO_FUNC_SIO };
+
+void gpio_init(uint gpio);
+void gpio_set_dir(uint gpio, bool out);
+void gpio_put(uint gpio, bool value);
+void gpio_set_mask(uint32_t mask);
+void gpio_clr_mask(uint32_t mask);
+void gpio_set_function(uint gpio, enum gpio_function fn);
+void gpio_pull_up(uint gpio);
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "hardware/gpio.h"
+#include "pico/stdlib.h"
+
+// No device answers on the host: writes and reads fail, so the EEPROM and
+// the display are reported absent.
+
+#define I2C_IC_DATA_CMD_STOP_BITS 0x200u
+#define I2C_IC_DATA_CMD_RESTART_BITS 0x400u
+#define I2C_IC_STATUS_TFE_BITS 0x4u
+#define I2C_IC_STATUS_MST_ACTIVITY_BITS 0x20u
+#define I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS 0x40u
+
+typedef struct {
+  volatile uint32_t enable;
+  volatile uint32_t tar;
+  volatile uint32_t data_cmd;
+  volatile uint32_t status;
+  volatile uint32_t raw_intr_stat;
+  volatile uint32_t clr_tx_abrt;
+} i2c_hw_t;
+
+typedef struct i2c_inst {
+  i2c_hw_t hw;
+} i2c_inst_t;
+
+extern i2c_inst_t i2c0_inst, i2c1_inst;
+#define i2c0 (&i2c0_inst)
+#define i2c1 (&i2c1_inst)
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate);
+int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src,
+                       size_t len, bool nostop);
+int i2c_read_blocking(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len,
+                      bool nostop);
+static inline i2c_hw_t *i2c_get_hw(i2c_inst_t *i2c) { return &i2c->hw; }
+static inline uint i2c_get_dreq(i2c_inst_t *i2c, bool is_tx) { return 0; }
@@ -0,0 +1,5 @@
+#pragma once
+
+#include "pico/stdlib.h"
+
+void multicore_launch_core1(void (*entry)());
@@ -0,0 +1,26 @@
+#pragma once
+
+// Host stand-in for the parts of the Pico SDK the firmware modules use.
+// Time comes from host_time_us (see host.h); interrupts are a no-op.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+typedef unsigned int uint;
+typedef uint64_t absolute_time_t;
+
+#define PICO_ERROR_TIMEOUT -1
+#define PICO_ERROR_GENERIC -2
+
+uint64_t time_us_64();
+uint32_t time_us_32();
+void sleep_ms(uint32_t ms);
+void sleep_us(uint64_t us);
+static inline void tight_loop_contents() {}
+
+uint32_t save_and_disable_interrupts();
+void restore_interrupts(uint32_t status);
+
+static inline absolute_time_t from_us_since_boot(uint64_t us) { return us; }
+static inline uint64_t to_us_since_boot(absolute_time_t t) { return t; }
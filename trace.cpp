@@ -0,0 +1,88 @@
+#include "trace.h"
+
+#if SEQ_TIMING_TRACE
+
+#include <cstdio>
+#include <cstring>
+
+TraceRing trace_rings[2];
+uint32_t trace_jitter_hist[TRACE_HIST_BINS];
+uint32_t trace_cv_latency_hist[TRACE_HIST_BINS];
+
+namespace {
+constexpr uint32_t BINARY_MAGIC = 0x31435254; // "TRC1"
+
+uint32_t bin_floor_us(uint32_t bin) {
+  return bin < 16 ? bin : (1u << (bin - 12));
+}
+
+// Histograms and rings are written by the owning core without locking; a
+// dump may mix records from just before and after it started.
+void dump_hist(const char *name, const uint32_t *hist) {
+  printf("%s", name);
+  for (uint32_t bin = 0; bin < TRACE_HIST_BINS; bin++) {
+    if (hist[bin])
+      printf(" %lu:%lu", (unsigned long)bin_floor_us(bin), (unsigned long)hist[bin]);
+  }
+  printf("\n");
+}
+
+void dump_text() {
+  static const char KIND_CHARS[] = "TCGgU";
+  dump_hist("jitter_us", trace_jitter_hist);
+  dump_hist("cv_latency_us", trace_cv_latency_hist);
+  for (uint32_t core = 0; core < 2; core++) {
+    const TraceRing &ring = trace_rings[core];
+    uint32_t end = ring.next;
+    uint32_t count = end < TRACE_RING_SIZE ? end : TRACE_RING_SIZE;
+    printf("core%lu", (unsigned long)core);
+    for (uint32_t i = end - count; i != end; i++) {
+      uint32_t rec = ring.records[i & (TRACE_RING_SIZE - 1)];
+      uint32_t kind = rec >> 28;
+      printf(" %c%lu", kind < sizeof(KIND_CHARS) - 1 ? KIND_CHARS[kind] : '?',
+             (unsigned long)(rec & TRACE_TIME_MASK));
+    }
+    printf("\n");
+  }
+}
+
+// Block layout (little-endian words): magic, bin count, jitter bins,
+// latency bins, then per core: record count followed by the records,
+// oldest first.
+void dump_binary() {
+  uint32_t header[2] = {BINARY_MAGIC, TRACE_HIST_BINS};
+  fwrite(header, sizeof(uint32_t), 2, stdout);
+  fwrite(trace_jitter_hist, sizeof(uint32_t), TRACE_HIST_BINS, stdout);
+  fwrite(trace_cv_latency_hist, sizeof(uint32_t), TRACE_HIST_BINS, stdout);
+  for (uint32_t core = 0; core < 2; core++) {
+    const TraceRing &ring = trace_rings[core];
+    uint32_t end = ring.next;
+    uint32_t count = end < TRACE_RING_SIZE ? end : TRACE_RING_SIZE;
+    fwrite(&count, sizeof(uint32_t), 1, stdout);
+    for (uint32_t i = end - count; i != end; i++) {
+      fwrite(&ring.records[i & (TRACE_RING_SIZE - 1)], sizeof(uint32_t), 1, stdout);
+    }
+  }
+  fflush(stdout);
+}
+} // namespace
+
+bool trace_command(int c) {
+  if (c == 't') {
+    dump_text();
+  } else if (c == 'b') {
+    dump_binary();
+  } else if (c == 'r') {
+    memset(trace_jitter_hist, 0, sizeof(trace_jitter_hist));
+    memset(trace_cv_latency_hist, 0, sizeof(trace_cv_latency_hist));
+  } else {
+    return false;
+  }
+  return true;
+}
+
+#else
+
+bool trace_command(int) { return false; }
+
+#endif
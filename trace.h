@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+
+// Timing instrumentation. Each core appends packed 32-bit records (event
+// kind in the top 4 bits, microsecond timestamp in the low 28) to its own
+// rolling ring, and core1 keeps histograms of tick jitter (report vs ideal
+// deadline) and CV latency (scheduled time to DAC write). Recording is a
+// timer read and a store. Build with SEQ_TIMING_TRACE=0 to compile every
+// hook away.
+
+#ifndef SEQ_TIMING_TRACE
+#define SEQ_TIMING_TRACE 1
+#endif
+
+enum TraceKind : uint8_t {
+  TRACE_TICK,     // tick reported (core1)
+  TRACE_CV,       // DAC write finished (core1)
+  TRACE_GATE_ON,  // (core1)
+  TRACE_GATE_OFF, // (core1)
+  TRACE_UI_STEP,  // step event picked up by the UI (core0)
+};
+
+#if SEQ_TIMING_TRACE
+
+#include "hardware/sync.h"
+#include "pico/stdlib.h"
+
+constexpr uint32_t TRACE_RING_SIZE = 256; // records per core, power of two
+constexpr uint32_t TRACE_HIST_BINS = 32;
+constexpr uint32_t TRACE_TIME_MASK = 0x0FFFFFFF;
+
+struct TraceRing {
+  uint32_t records[TRACE_RING_SIZE];
+  volatile uint32_t next;
+};
+
+extern TraceRing trace_rings[2];
+extern uint32_t trace_jitter_hist[TRACE_HIST_BINS];
+extern uint32_t trace_cv_latency_hist[TRACE_HIST_BINS];
+
+// 1 us bins up to 15 us, then one bin per power of two.
+inline uint32_t trace_bin(uint32_t us) {
+  if (us < 16)
+    return us;
+  uint32_t bin = 12 + (31 - __builtin_clz(us));
+  return bin < TRACE_HIST_BINS ? bin : TRACE_HIST_BINS - 1;
+}
+
+inline uint32_t trace_record(TraceKind kind) {
+  uint32_t now = time_us_32();
+  TraceRing &ring = trace_rings[get_core_num()];
+  uint32_t i = ring.next;
+  ring.records[i & (TRACE_RING_SIZE - 1)] =
+      ((uint32_t)kind << 28) | (now & TRACE_TIME_MASK);
+  ring.next = i + 1;
+  return now;
+}
+
+#define TRACE_EVENT(kind) trace_record(kind)
+// Record the tick handler start and its jitter against `deadline_us`.
+#define TRACE_TICK_START(deadline_us)                                         \
+  trace_jitter_hist[trace_bin(trace_record(TRACE_TICK) - (uint32_t)(deadline_us))]++
+// Record the end of the CV write and its latency from `deadline_us`.
+#define TRACE_CV_DONE(deadline_us)                                            \
+  trace_cv_latency_hist[trace_bin(trace_record(TRACE_CV) - (uint32_t)(deadline_us))]++
+
+#else
+
+#define TRACE_EVENT(kind) ((void)0)
+#define TRACE_TICK_START(deadline_us) ((void)0)
+#define TRACE_CV_DONE(deadline_us) ((void)0)
+
+#endif
+
+// Console commands: 't' dumps histograms and recent records as text, 'b'
+// dumps the same as a binary block, 'r' resets the histograms. Returns true
+// if `c` was handled (never when tracing is compiled out).
+bool trace_command(int c);
@@ -1,5 +1,6 @@
 #include "ui.h"
 
+#include "hardware/dma.h"
 #include "hardware/i2c.h"
 #include "pico/stdlib.h"
 #include "sequencer.h"
@@ -12,16 +13,53 @@ static const int SCL_PIN = 5;
 static const uint8_t SSD1306_ADDR = 0x3C;
 
 static uint8_t fb[128 * 8];
-
-static int32_t ui_edit_step_prev_step = -1;
-static uint8_t ui_edit_step_prev_note = 0;
-static uint16_t ui_edit_step_prev_gate = 0xFFFF;
-static uint8_t ui_edit_note_prev_note = 255;
-static bool ui_edit_note_prev_gate = false;
-static uint32_t ui_edit_note_prev_step = 255;
-static int8_t ui_pattern_select_prev_slot = -1;
-
-static const uint8_t font5x7[][5] = {
+// Copy of what the panel shows, used to trim flushes to the bytes that
+// actually changed. A frame is copied in only once ui_flush_busy() sees its
+// transfer complete without an abort. Invalid until the first full flush
+// after init.
+static uint8_t fb_shown[128 * 8];
+static bool fb_shown_valid = false;
+
+// Per-page dirty column span; a page is clean when dirty_x0 > dirty_x1.
+static uint8_t dirty_x0[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+static uint8_t dirty_x1[8] = {127, 127, 127, 127, 127, 127, 127, 127};
+
+// DMA flush engine: each frame is encoded as IC_DATA_CMD words (one I2C
+// transaction per command window and per data run, STOP on the last word)
+// into flush_stream, which is the back buffer the DMA channel drains while
+// drawing continues in fb.
+static bool display_present = false;
+static int flush_dma_chan = -1;
+static uint16_t flush_stream[8 * (7 + 129)];
+
+// Windows of the frame in flight: columns x0..x1 of pages p0..p1, whose
+// data starts at flush_stream[data].
+struct FlushWindow {
+  uint8_t x0, x1, p0, p1;
+  uint16_t data;
+};
+static FlushWindow frame_windows[8];
+static int frame_window_count = 0;
+
+// Render scheduler: ui_show_* only draw into fb and mark regions dirty;
+// ui_commit() ships them in at most one flush per frame interval.
+constexpr uint32_t UI_DEFAULT_FPS = 30;
+static uint64_t frame_interval_us = 1000000 / UI_DEFAULT_FPS;
+static uint64_t last_frame_us = 0;
+
+// Flush timing: init command stream and the last frame's wire time (DMA
+// start until the I2C FIFO drained, as observed by ui_flush_busy()).
+static uint32_t init_time_us = 0;
+static uint32_t frame_time_us = 0;
+static uint64_t frame_start_us = 0;
+static bool frame_in_flight = false;
+
+// Bytes written to the display since the last tick, and per-tick history.
+static uint32_t flush_bytes_accum = 0;
+static uint32_t flush_bytes_last_tick = 0;
+static uint32_t flush_bytes_max_tick = 0;
+
+static constexpr uint8_t font5x7[][5] = {
     {0x00, 0x00, 0x00, 0x00, 0x00}, {0x3E, 0x51, 0x49, 0x45, 0x3E}, // 0
     {0x00, 0x42, 0x7F, 0x40, 0x00},                                 // 1
     {0x42, 0x61, 0x51, 0x49, 0x46},                                 // 2
@@ -62,9 +100,38 @@ static const uint8_t font5x7[][5] = {
     {0x14, 0x7F, 0x14, 0x7F, 0x14},                                 // #
     {0x60, 0x30, 0x18, 0x0C, 0x06},                                 // /
     {0x41, 0x22, 0x14, 0x08, 0x00},                                 // >
-    {0x08, 0x14, 0x22, 0x41, 0x00}                                  // <
+    {0x08, 0x14, 0x22, 0x41, 0x00},                                 // <
+    {0x08, 0x08, 0x08, 0x08, 0x08},                                 // -
+    {0x08, 0x08, 0x3E, 0x08, 0x08},                                 // +
+    {0x23, 0x13, 0x08, 0x64, 0x62}                                  // %
 };
 
+constexpr int NUM_GLYPHS = sizeof(font5x7) / sizeof(font5x7[0]);
+
+// font5x7 expanded vertically at a fixed scale: each source column becomes
+// a 7*scale-bit column bitmap (LSB top), generated at compile time.
+struct ScaledGlyphs {
+  uint32_t cols[NUM_GLYPHS][5];
+};
+
+static constexpr ScaledGlyphs make_scaled_glyphs(int scale) {
+  ScaledGlyphs out{};
+  for (int g = 0; g < NUM_GLYPHS; ++g) {
+    for (int col = 0; col < 5; ++col) {
+      uint32_t bits = 0;
+      for (int row = 0; row < 7; ++row) {
+        if ((font5x7[g][col] >> row) & 1u)
+          bits |= ((1u << scale) - 1) << (row * scale);
+      }
+      out.cols[g][col] = bits;
+    }
+  }
+  return out;
+}
+
+static constexpr ScaledGlyphs font5x7_2x = make_scaled_glyphs(2);
+static constexpr ScaledGlyphs font5x7_3x = make_scaled_glyphs(3);
+
 static int char_to_font_index(char c) {
   if (c == ' ')
     return 0;
@@ -84,74 +151,303 @@ static int char_to_font_index(char c) {
     return 40;
   if (c == '<')
     return 41;
+  if (c == '-')
+    return 42;
+  if (c == '+')
+    return 43;
+  if (c == '%')
+    return 44;
   return 0;
 }
 
-static void ssd1306_write_command(uint8_t cmd) {
-  uint8_t buf[2] = {0x00, cmd};
-  i2c_write_blocking(i2c0, SSD1306_ADDR, buf, 2, false);
+static void ssd1306_write(const uint8_t *buf, size_t len) {
+  i2c_write_blocking(i2c0, SSD1306_ADDR, buf, len, false);
+  flush_bytes_accum += len;
+}
+
+// Send a command stream as control-byte-prefixed transactions of up to 32
+// command bytes each; the controller parses the stream across them.
+static void ssd1306_write_commands(const uint8_t *cmds, size_t len) {
+  uint8_t buf[33];
+  while (len > 0) {
+    size_t chunk = len < sizeof(buf) - 1 ? len : sizeof(buf) - 1;
+    buf[0] = 0x00;
+    memcpy(&buf[1], cmds, chunk);
+    ssd1306_write(buf, chunk + 1);
+    cmds += chunk;
+    len -= chunk;
+  }
+}
+
+// Mark columns x0..x1 of pages page0..page1 as needing a flush (clipped).
+static void mark_dirty(int x0, int x1, int page0, int page1) {
+  if (x0 < 0)
+    x0 = 0;
+  if (x1 > 127)
+    x1 = 127;
+  if (page0 < 0)
+    page0 = 0;
+  if (page1 > 7)
+    page1 = 7;
+  if (x0 > x1)
+    return;
+  for (int page = page0; page <= page1; ++page) {
+    if (dirty_x0[page] > dirty_x1[page]) {
+      dirty_x0[page] = (uint8_t)x0;
+      dirty_x1[page] = (uint8_t)x1;
+    } else {
+      if (x0 < dirty_x0[page])
+        dirty_x0[page] = (uint8_t)x0;
+      if (x1 > dirty_x1[page])
+        dirty_x1[page] = (uint8_t)x1;
+    }
+  }
 }
 
 static void ssd1306_init_chip() {
   // Basic init sequence for SSD1306 128x64
-  ssd1306_write_command(0xAE); // display off
-  ssd1306_write_command(0x20);
-  ssd1306_write_command(0x00);
-  ssd1306_write_command(0xB0);
-  ssd1306_write_command(0xC8);
-  ssd1306_write_command(0x00);
-  ssd1306_write_command(0x10);
-  ssd1306_write_command(0x40);
-  ssd1306_write_command(0x81);
-  ssd1306_write_command(0x7F);
-  ssd1306_write_command(0xA1);
-  ssd1306_write_command(0xA6);
-  ssd1306_write_command(0xA8);
-  ssd1306_write_command(0x3F);
-  ssd1306_write_command(0xA4);
-  ssd1306_write_command(0xD3);
-  ssd1306_write_command(0x00);
-  ssd1306_write_command(0xD5);
-  ssd1306_write_command(0xF0);
-  ssd1306_write_command(0xD9);
-  ssd1306_write_command(0x22);
-  ssd1306_write_command(0xDA);
-  ssd1306_write_command(0x12);
-  ssd1306_write_command(0xDB);
-  ssd1306_write_command(0x20);
-  ssd1306_write_command(0x8D);
-  ssd1306_write_command(0x14);
-  ssd1306_write_command(0xAF); // display on
-}
-
-static void ssd1306_clear_fb() { memset(fb, 0x00, sizeof(fb)); }
+  static const uint8_t init_cmds[] = {
+      0xAE,       // display off
+      0x20, 0x00, // horizontal addressing mode
+      0xB0, 0xC8, 0x00, 0x10, 0x40, 0x81, 0x7F, 0xA1, 0xA6, 0xA8, 0x3F,
+      0xA4, 0xD3, 0x00, 0xD5, 0xF0, 0xD9, 0x22, 0xDA, 0x12, 0xDB, 0x20,
+      0x8D, 0x14,
+      0xAF, // display on
+  };
+  ssd1306_write_commands(init_cmds, sizeof(init_cmds));
+}
 
+static void ssd1306_clear_fb() {
+  memset(fb, 0x00, sizeof(fb));
+  mark_dirty(0, 127, 0, 7);
+}
+
+// Append one I2C transaction (control byte + payload) to the flush stream.
+static int stream_put(uint16_t *dst, uint8_t control, const uint8_t *data,
+                      int len) {
+  dst[0] = control;
+  for (int i = 0; i < len; ++i)
+    dst[1 + i] = data[i];
+  dst[len] |= I2C_IC_DATA_CMD_STOP_BITS;
+  return len + 1;
+}
+
+// Extra bytes a window is allowed to resend to avoid opening a new one:
+// a window costs one 8-byte command transaction plus the data control byte
+// and the address/START/STOP framing of two transactions.
+constexpr int WINDOW_OVERHEAD = 12;
+
+// Queue the dirty pages, each trimmed to the column span that differs from
+// what the panel already shows, and return without waiting. The chip runs
+// in horizontal addressing mode, so adjacent dirty pages are merged into one
+// column/page window whenever that is cheaper than a separate window; a full
+// frame is a single window command plus one continuous data transfer. If the
+// previous frame is still being transferred the dirty regions are kept for
+// the next call.
 void ssd1306_update() {
-  for (uint8_t page = 0; page < 8; ++page) {
-    ssd1306_write_command(0xB0 | page);
-    ssd1306_write_command(0x00);
-    ssd1306_write_command(0x10);
-
-    uint8_t buf[129];
-    buf[0] = 0x40;
-    memcpy(&buf[1], &fb[page * 128], 128);
-    i2c_write_blocking(i2c0, SSD1306_ADDR, buf, 129, false);
+  if (!display_present) {
+    for (int page = 0; page < 8; ++page) {
+      dirty_x0[page] = 1;
+      dirty_x1[page] = 0;
+    }
+    return;
+  }
+  if (frame_in_flight && ui_flush_busy())
+    return;
+
+  int span_x0[8];
+  int span_x1[8];
+  for (int page = 0; page < 8; ++page) {
+    int x0 = dirty_x0[page];
+    int x1 = dirty_x1[page];
+    dirty_x0[page] = 1;
+    dirty_x1[page] = 0;
+    if (x0 <= x1 && fb_shown_valid) {
+      const uint8_t *src = &fb[page * 128];
+      const uint8_t *shown = &fb_shown[page * 128];
+      while (x0 <= x1 && src[x0] == shown[x0])
+        ++x0;
+      while (x1 >= x0 && src[x1] == shown[x1])
+        --x1;
+    }
+    span_x0[page] = x0;
+    span_x1[page] = x1;
+  }
+
+  int n = 0;
+  int page = 0;
+  frame_window_count = 0;
+  while (page < 8) {
+    if (span_x0[page] > span_x1[page]) {
+      ++page;
+      continue;
+    }
+    int p0 = page;
+    int p1 = page;
+    int x0 = span_x0[page];
+    int x1 = span_x1[page];
+    while (p1 + 1 < 8 && span_x0[p1 + 1] <= span_x1[p1 + 1]) {
+      int nx0 = (span_x0[p1 + 1] < x0) ? span_x0[p1 + 1] : x0;
+      int nx1 = (span_x1[p1 + 1] > x1) ? span_x1[p1 + 1] : x1;
+      int merged = (p1 + 2 - p0) * (nx1 - nx0 + 1);
+      int split = (p1 + 1 - p0) * (x1 - x0 + 1) +
+                  (span_x1[p1 + 1] - span_x0[p1 + 1] + 1) + WINDOW_OVERHEAD;
+      if (merged > split)
+        break;
+      ++p1;
+      x0 = nx0;
+      x1 = nx1;
+    }
+
+    const uint8_t window[6] = {0x21, (uint8_t)x0, (uint8_t)x1,
+                               0x22, (uint8_t)p0, (uint8_t)p1};
+    n += stream_put(&flush_stream[n], 0x00, window, 6);
+
+    int len = x1 - x0 + 1;
+    flush_stream[n++] = 0x40;
+    frame_windows[frame_window_count++] = {(uint8_t)x0, (uint8_t)x1,
+                                           (uint8_t)p0, (uint8_t)p1,
+                                           (uint16_t)n};
+    for (int p = p0; p <= p1; ++p) {
+      const uint8_t *src = &fb[p * 128 + x0];
+      for (int i = 0; i < len; ++i)
+        flush_stream[n++] = src[i];
+    }
+    flush_stream[n - 1] |= I2C_IC_DATA_CMD_STOP_BITS;
+    page = p1 + 1;
+  }
+  if (n == 0)
+    return;
+
+  // A NACK from a previous frame leaves the TX FIFO flushed until cleared.
+  i2c_hw_t *hw = i2c_get_hw(i2c0);
+  if (hw->raw_intr_stat & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS)
+    (void)hw->clr_tx_abrt;
+
+  flush_bytes_accum += n;
+  frame_start_us = time_us_64();
+  frame_in_flight = true;
+  dma_channel_transfer_from_buffer_now(flush_dma_chan, flush_stream, n);
+}
+
+static bool fb_has_dirty() {
+  for (int page = 0; page < 8; ++page) {
+    if (dirty_x0[page] <= dirty_x1[page])
+      return true;
+  }
+  return false;
+}
+
+void ui_set_frame_rate(uint32_t fps) {
+  if (fps < 1)
+    fps = 1;
+  frame_interval_us = 1000000 / fps;
+}
+
+bool ui_commit() {
+  if (frame_in_flight && ui_flush_busy())
+    return false;
+  if (!fb_has_dirty())
+    return false;
+  uint64_t now_us = time_us_64();
+  if ((now_us - last_frame_us) < frame_interval_us)
+    return false;
+  last_frame_us = now_us;
+  ssd1306_update();
+  return true;
+}
+
+// The frame in flight has left the FIFO: on success its windows are now on
+// the panel; after an abort (NACK, bus reset) they are queued again.
+static void frame_finished(bool aborted) {
+  for (int w = 0; w < frame_window_count; ++w) {
+    const FlushWindow &win = frame_windows[w];
+    if (aborted) {
+      mark_dirty(win.x0, win.x1, win.p0, win.p1);
+      continue;
+    }
+    int len = win.x1 - win.x0 + 1;
+    const uint16_t *src = &flush_stream[win.data];
+    for (int p = win.p0; p <= win.p1; ++p) {
+      uint8_t *shown = &fb_shown[p * 128 + win.x0];
+      for (int i = 0; i < len; ++i)
+        shown[i] = (uint8_t)*src++;
+    }
   }
+  frame_window_count = 0;
+  // The first frame after init covers the whole panel.
+  if (!aborted)
+    fb_shown_valid = true;
 }
 
-static void ssd1306_update_region(uint8_t start_page, uint8_t end_page) {
-  for (uint8_t page = start_page; page <= end_page && page < 8; ++page) {
-    ssd1306_write_command(0xB0 | page);
-    ssd1306_write_command(0x00);
-    ssd1306_write_command(0x10);
+bool ui_flush_busy() {
+  if (!display_present)
+    return false;
+  if (dma_channel_is_busy(flush_dma_chan))
+    return true;
+  uint32_t status = i2c_get_hw(i2c0)->status;
+  bool busy = !(status & I2C_IC_STATUS_TFE_BITS) ||
+              (status & I2C_IC_STATUS_MST_ACTIVITY_BITS);
+  if (!busy && frame_in_flight) {
+    frame_time_us = (uint32_t)(time_us_64() - frame_start_us);
+    frame_in_flight = false;
+    frame_finished(i2c_get_hw(i2c0)->raw_intr_stat &
+                   I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS);
+  }
+  return busy;
+}
+
+uint32_t ui_init_time_us() { return init_time_us; }
 
-    uint8_t buf[129];
-    buf[0] = 0x40;
-    memcpy(&buf[1], &fb[page * 128], 128);
-    i2c_write_blocking(i2c0, SSD1306_ADDR, buf, 129, false);
+uint32_t ui_last_frame_time_us() { return frame_time_us; }
+
+// Frame caps the console steps through.
+static constexpr uint32_t CONSOLE_FRAME_RATES[] = {15, 30, 60};
+
+static void ui_print_timing() {
+  printf("display init %lu us, last frame %lu us, cap %lu fps\n",
+         (unsigned long)init_time_us, (unsigned long)frame_time_us,
+         (unsigned long)(1000000 / frame_interval_us));
+}
+
+bool ui_command(int c) {
+  if (c == 'd') {
+    ui_print_timing();
+    return true;
+  }
+  if (c == 'f') {
+    uint32_t fps = (uint32_t)(1000000 / frame_interval_us);
+    uint32_t next = CONSOLE_FRAME_RATES[0];
+    for (uint32_t rate : CONSOLE_FRAME_RATES) {
+      if (rate > fps) {
+        next = rate;
+        break;
+      }
+    }
+    ui_set_frame_rate(next);
+    ui_print_timing();
+    return true;
+  }
+  return false;
+}
+
+void ui_flush_wait() {
+  while (ui_flush_busy()) {
+    tight_loop_contents();
   }
 }
 
+void ui_flush_stats_tick() {
+  flush_bytes_last_tick = flush_bytes_accum;
+  if (flush_bytes_accum > flush_bytes_max_tick)
+    flush_bytes_max_tick = flush_bytes_accum;
+  flush_bytes_accum = 0;
+}
+
+uint32_t ui_flush_bytes_last_tick() { return flush_bytes_last_tick; }
+
+uint32_t ui_flush_bytes_max_tick() { return flush_bytes_max_tick; }
+
 static void ui_draw_char(int x, int page, char c) {
   int idx = char_to_font_index(c);
   const uint8_t *glyph = font5x7[idx];
@@ -161,6 +457,7 @@ static void ui_draw_char(int x, int page, char c) {
   for (int i = 0; i < 5; ++i)
     dst[i] = glyph[i];
   dst[5] = 0x00;
+  mark_dirty(x, x + 5, page, page);
 }
 
 static void ui_draw_text(int x, int page, const char *str) {
@@ -178,6 +475,7 @@ static void set_pixel(int x, int y) {
   int page = y >> 3;
   int bit = y & 7;
   fb[page * 128 + x] |= (1u << bit);
+  mark_dirty(x, x, page, page);
 }
 
 static void clear_pixel(int x, int y) {
@@ -186,11 +484,40 @@ static void clear_pixel(int x, int y) {
   int page = y >> 3;
   int bit = y & 7;
   fb[page * 128 + x] &= ~(1u << bit);
+  mark_dirty(x, x, page, page);
 }
 
 void draw_scaled_char(int x0, int y0, char c, int scale) {
   int idx = char_to_font_index(c);
   const uint8_t *glyph = font5x7[idx];
+
+  // Fast path: OR pre-scaled column bitmaps into whole page bytes.
+  if ((scale == 2 || scale == 3) && y0 >= 0 && y0 < 64) {
+    const uint32_t *cols =
+        (scale == 2) ? font5x7_2x.cols[idx] : font5x7_3x.cols[idx];
+    int page0 = y0 >> 3;
+    int shift = y0 & 7;
+    int page1 = (y0 + 7 * scale - 1) >> 3;
+    if (page1 > 7)
+      page1 = 7;
+    for (int col = 0; col < 5; ++col) {
+      uint32_t bits = cols[col] << shift;
+      if (!bits)
+        continue;
+      for (int dx = 0; dx < scale; ++dx) {
+        int x = x0 + col * scale + dx;
+        if (x < 0 || x >= 128)
+          continue;
+        uint8_t *dst = &fb[page0 * 128 + x];
+        uint32_t v = bits;
+        for (int page = page0; page <= page1; ++page, v >>= 8, dst += 128)
+          *dst |= (uint8_t)v;
+      }
+    }
+    mark_dirty(x0, x0 + 5 * scale - 1, page0, page1);
+    return;
+  }
+
   // glyph: 5 columns, 7 rows (LSB top)
   for (int col = 0; col < 5; ++col) {
     uint8_t colbits = glyph[col];
@@ -223,7 +550,27 @@ void ui_init() {
     return;
   }
 
+  uint64_t init_start_us = time_us_64();
   ssd1306_init_chip();
+  init_time_us = (uint32_t)(time_us_64() - init_start_us);
+
+  // All further traffic goes through DMA; IC_TAR stays fixed at the panel.
+  i2c_hw_t *hw = i2c_get_hw(i2c0);
+  hw->enable = 0;
+  hw->tar = SSD1306_ADDR;
+  hw->enable = 1;
+
+  flush_dma_chan = dma_claim_unused_channel(true);
+  dma_channel_config cfg = dma_channel_get_default_config(flush_dma_chan);
+  channel_config_set_transfer_data_size(&cfg, DMA_SIZE_16);
+  channel_config_set_read_increment(&cfg, true);
+  channel_config_set_write_increment(&cfg, false);
+  channel_config_set_dreq(&cfg, i2c_get_dreq(i2c0, true));
+  dma_channel_configure(flush_dma_chan, &cfg, &hw->data_cmd, flush_stream, 0,
+                        false);
+  display_present = true;
+
+  fb_shown_valid = false;
   ssd1306_clear_fb();
   ssd1306_update();
 }
@@ -312,59 +659,7 @@ void ui_boot_animation() {
 
   ssd1306_clear_fb();
   ssd1306_update();
-}
-
-void ui_clear() {
-  ssd1306_clear_fb();
-  ssd1306_update();
-
-  ui_edit_step_prev_step = -1;
-  ui_edit_step_prev_note = 0;
-  ui_edit_step_prev_gate = 0xFFFF;
-  ui_edit_note_prev_note = 255;
-  ui_edit_note_prev_gate = false;
-  ui_edit_note_prev_step = 255;
-  ui_pattern_select_prev_slot = -1;
-}
-
-void ui_show_bpm(uint32_t bpm, uint8_t pattern_slot, bool blink_slot) {
-  char numbuf[16];
-  int numlen = snprintf(numbuf, sizeof(numbuf), "%u", (unsigned)bpm);
-  if (numlen <= 0)
-    return;
-
-  // Larger BPM display at top-left using 2x scale
-  // Clear entire top area for BPM (2 pages height, full width)
-  for (int i = 0; i < 128; ++i) {
-    fb[0 * 128 + i] = 0x00;
-    fb[1 * 128 + i] = 0x00;
-  }
-
-  int x = 0;
-  // Draw label "BPM:" with 2x scale
-  const char *label = "BPM:";
-  for (const char *p = label; *p; ++p) {
-    draw_scaled_char(x, 0, *p, 2);
-    x += 12; // 5*2 + 2 spacing
-  }
-  // Draw BPM number with 2x scale
-  for (int i = 0; i < numlen; ++i) {
-    draw_scaled_char(x, 0, numbuf[i], 2);
-    x += 12;
-  }
-
-  // Draw pattern slot on right side (P:0-9) - skip if blinking
-  if (!blink_slot) {
-    char slot_buf[8];
-    snprintf(slot_buf, sizeof(slot_buf), "P:%d", pattern_slot);
-    int slot_x = 128 - (strlen(slot_buf) * 12); // Right align
-    for (const char *p = slot_buf; *p; ++p) {
-      draw_scaled_char(slot_x, 0, *p, 2);
-      slot_x += 12;
-    }
-  }
-
-  ssd1306_update();
+  ui_flush_wait();
 }
 
 // Helper: clear rectangular region (inclusive) in pixel coords
@@ -388,6 +683,7 @@ void clear_region(int x0, int y0, int w, int h) {
       fb[page * 128 + x] &= ~(1u << bit);
     }
   }
+  mark_dirty(x0, x1, y0 >> 3, y1 >> 3);
 }
 
 // Helper: draw scaled text
@@ -417,48 +713,6 @@ static void fill_rect(int x0, int y0, int w, int h) {
   }
 }
 
-void ui_show_steps(uint32_t current_step, uint32_t steps) {
-  if (steps == 0)
-    return;
-  const int sq = 12;
-  const int spacing = 4;
-  const int cols = 8;
-  const int total_w = cols * sq + (cols - 1) * spacing; // 124
-  const int left = (128 - total_w) / 2;
-  // Move to bottom: screen is 64 pixels high, 2 rows of squares with gap
-  const int bottom_y = 64 - sq;        // Bottom row at very bottom
-  const int top_y = bottom_y - sq - 8; // Top row above with 8px gap
-
-  // Clear grid area
-  clear_region(left - 1, top_y - 1, total_w + 2, (sq * 2) + 8 + 2);
-
-  for (int i = 0; i < (int)steps && i < 16; ++i) {
-    int col = i % cols;
-    int row = i / cols;
-    int x = left + col * (sq + spacing);
-    int y = (row == 0) ? top_y : bottom_y;
-
-    bool is_current = (i == (int)current_step && current_step < steps);
-    bool gate_enabled = seq_get_gate_enabled(i);
-
-    if (is_current) {
-      fill_rect(x + 2, y + 2, sq - 4, sq - 4);
-    } else {
-      draw_rect_outline(x, y, sq, sq);
-    }
-
-    if (gate_enabled) {
-      if (is_current) {
-        clear_region(x + 3, y + 3, 6, 6);
-      } else {
-        fill_rect(x + 3, y + 3, 6, 6);
-      }
-    }
-  }
-
-  ssd1306_update();
-}
-
 // Helper: Convert MIDI note to name (e.g., 48 -> "C3")
 static void note_to_string(uint8_t note, char *buf) {
   const char *notes[] = {"C",  "C#", "D",  "D#", "E",  "F",
@@ -468,159 +722,337 @@ static void note_to_string(uint8_t note, char *buf) {
   sprintf(buf, "%s%d", notes[semitone], octave);
 }
 
-void ui_show_edit_step(uint32_t selected_step, uint8_t note) {
-  const int cols = 8;
-  const int sq = 12;
-  const int spacing = 4;
-  const int total_w = cols * sq + (cols - 1) * spacing;
-  const int left = (128 - total_w) / 2;
-  const int bottom_y = 64 - sq;
-  const int top_y = bottom_y - sq - 8;
+// Retained widgets: each one remembers the value it last drew and owns a
+// fixed bounding box. Setting a widget redraws it only when the value
+// changed, clearing just its box, so the dirty regions handed to the flush
+// scale with what changed rather than with the screen.
+enum TextAlign : uint8_t { ALIGN_LEFT, ALIGN_RIGHT, ALIGN_CENTER };
+
+struct TextWidget {
+  int16_t x, y, w, h; // box cleared on redraw
+  int16_t text_y;     // glyph origin; must be page aligned for scale 1
+  uint8_t scale;
+  TextAlign align;
+  char text[24] = {};
+  bool valid = false;
+};
 
-  bool first_draw = (ui_edit_step_prev_step == -1);
+static void text_widget_set(TextWidget &w, const char *text) {
+  if (w.valid && strcmp(w.text, text) == 0)
+    return;
+  snprintf(w.text, sizeof(w.text), "%s", text);
+  w.valid = true;
 
-  if (first_draw) {
-    ssd1306_clear_fb();
-    ui_draw_text(0, 0, "STEP SELECT");
+  clear_region(w.x, w.y, w.w, w.h);
+  int len = (int)strlen(w.text);
+  if (len == 0)
+    return;
+  int advance = (w.scale == 1) ? 6 : (5 * w.scale) + 2;
+  int width = len * advance - (advance - 5 * w.scale);
+  int x = w.x;
+  if (w.align == ALIGN_RIGHT)
+    x = w.x + w.w - width;
+  else if (w.align == ALIGN_CENTER)
+    x = w.x + (w.w - width) / 2;
+
+  if (w.scale == 1)
+    ui_draw_text(x, w.text_y >> 3, w.text);
+  else
+    draw_scaled_text(x, w.text_y, w.text, w.scale);
+}
 
-    for (int i = 0; i < 16; ++i) {
-      int col = i % cols;
-      int row = i / cols;
-      int x = left + col * (sq + spacing);
-      int step_y = (row == 0) ? top_y : bottom_y;
-      bool is_selected = (i == (int)selected_step);
-      bool gate_enabled = seq_get_gate_enabled(i);
+// 16-step grid, 8 squares per row, showing one 16-step page of the
+// pattern. Each cell keeps its last drawn state.
+enum GridStyle : uint8_t { GRID_PLAY, GRID_EDIT };
 
-      if (is_selected) {
-        draw_rect_outline(x, step_y, sq, sq);
-        if (gate_enabled) {
-          fill_rect(x + 3, step_y + 3, 6, 6);
-        }
-      } else {
-        draw_rect_outline(x + 2, step_y + 2, sq - 4, sq - 4);
-        if (gate_enabled) {
-          fill_rect(x + 4, step_y + 4, 4, 4);
-        }
-      }
-    }
-  } else {
-    clear_region(0, 16, 128, 8);
+constexpr uint8_t CELL_VISIBLE = 1 << 0;
+constexpr uint8_t CELL_ACTIVE = 1 << 1; // playing step / selected step
+constexpr uint8_t CELL_GATE = 1 << 2;
 
-    uint16_t current_gate_mask = 0;
-    for (int i = 0; i < 16; i++) {
-      if (seq_get_gate_enabled(i))
-        current_gate_mask |= (1 << i);
-    }
+constexpr uint32_t GRID_CELLS = 16;
 
-    if (ui_edit_step_prev_step != (int32_t)selected_step) {
-      int old_col = ui_edit_step_prev_step % cols;
-      int old_row = ui_edit_step_prev_step / cols;
-      int old_x = left + old_col * (sq + spacing);
-      int old_y = (old_row == 0) ? top_y : bottom_y;
-      clear_region(old_x, old_y, sq, sq);
-      bool old_gate = seq_get_gate_enabled(ui_edit_step_prev_step);
-      draw_rect_outline(old_x + 2, old_y + 2, sq - 4, sq - 4);
-      if (old_gate) {
-        fill_rect(old_x + 4, old_y + 4, 4, 4);
-      }
+// First step of the grid page holding `step`.
+static uint32_t grid_page_base(uint32_t step) {
+  return step - step % GRID_CELLS;
+}
 
-      int new_col = selected_step % cols;
-      int new_row = selected_step / cols;
-      int new_x = left + new_col * (sq + spacing);
-      int new_y = (new_row == 0) ? top_y : bottom_y;
-      clear_region(new_x, new_y, sq, sq);
-      bool new_gate = seq_get_gate_enabled(selected_step);
-      draw_rect_outline(new_x, new_y, sq, sq);
-      if (new_gate) {
-        fill_rect(new_x + 3, new_y + 3, 6, 6);
-      }
-    } else if (current_gate_mask != ui_edit_step_prev_gate) {
-      int col = selected_step % cols;
-      int row = selected_step / cols;
-      int x = left + col * (sq + spacing);
-      int y = (row == 0) ? top_y : bottom_y;
-      clear_region(x, y, sq, sq);
-      bool gate = seq_get_gate_enabled(selected_step);
+struct GridWidget {
+  GridStyle style;
+  uint8_t cells[GRID_CELLS] = {};
+  bool valid = false;
+};
+
+constexpr int GRID_SQ = 12;
+constexpr int GRID_SPACING = 4;
+constexpr int GRID_COLS = 8;
+constexpr int GRID_TOTAL_W =
+    GRID_COLS * GRID_SQ + (GRID_COLS - 1) * GRID_SPACING; // 124
+constexpr int GRID_LEFT = (128 - GRID_TOTAL_W) / 2;
+// Screen is 64 pixels high: bottom row at the very bottom, top row above it
+// with an 8px gap.
+constexpr int GRID_BOTTOM_Y = 64 - GRID_SQ;
+constexpr int GRID_TOP_Y = GRID_BOTTOM_Y - GRID_SQ - 8;
+
+static void grid_draw_cell(GridStyle style, int i, uint8_t state) {
+  int x = GRID_LEFT + (i % GRID_COLS) * (GRID_SQ + GRID_SPACING);
+  int y = (i < GRID_COLS) ? GRID_TOP_Y : GRID_BOTTOM_Y;
+  const int sq = GRID_SQ;
+
+  clear_region(x, y, sq, sq);
+  if (!(state & CELL_VISIBLE))
+    return;
+
+  bool active = state & CELL_ACTIVE;
+  bool gate = state & CELL_GATE;
+  if (style == GRID_PLAY) {
+    if (active) {
+      fill_rect(x + 2, y + 2, sq - 4, sq - 4);
+      if (gate)
+        clear_region(x + 3, y + 3, 6, 6);
+    } else {
       draw_rect_outline(x, y, sq, sq);
-      if (gate) {
+      if (gate)
         fill_rect(x + 3, y + 3, 6, 6);
-      }
     }
+  } else {
+    if (active) {
+      draw_rect_outline(x, y, sq, sq);
+      if (gate)
+        fill_rect(x + 3, y + 3, 6, 6);
+    } else {
+      draw_rect_outline(x + 2, y + 2, sq - 4, sq - 4);
+      if (gate)
+        fill_rect(x + 4, y + 4, 4, 4);
+    }
+  }
+}
 
-    ui_edit_step_prev_gate = current_gate_mask;
+static void grid_widget_set(GridWidget &g, const uint8_t cells[GRID_CELLS]) {
+  for (uint32_t i = 0; i < GRID_CELLS; ++i) {
+    if (g.valid && g.cells[i] == cells[i])
+      continue;
+    g.cells[i] = cells[i];
+    grid_draw_cell(g.style, i, cells[i]);
   }
+  g.valid = true;
+}
 
-  char buf[32];
-  char note_str[8];
-  note_to_string(note, note_str);
-  sprintf(buf, "Step:%02d  Note:%s", selected_step + 1, note_str);
-  ui_draw_text(0, 2, buf);
+// Main screen
+static TextWidget bpm_value_w = {48, 0, 34, 16, 0, 2, ALIGN_LEFT};
+static TextWidget bpm_slot_w = {82, 0, 46, 16, 0, 2, ALIGN_RIGHT};
+static TextWidget song_w = {0, 16, 128, 8, 16, 1, ALIGN_LEFT};
+static GridWidget play_grid_w = {GRID_PLAY};
+// Step select
+static TextWidget edit_step_info_w = {0, 16, 128, 8, 16, 1, ALIGN_LEFT};
+static GridWidget edit_grid_w = {GRID_EDIT};
+// Note edit
+static TextWidget note_step_w = {0, 16, 128, 8, 16, 1, ALIGN_LEFT};
+static TextWidget note_cv_b_w = {0, 24, 128, 8, 24, 1, ALIGN_LEFT};
+static TextWidget note_gate_w = {0, 32, 128, 8, 32, 1, ALIGN_LEFT};
+static TextWidget note_value_w = {0, 40, 128, 24, 47, 2, ALIGN_CENTER};
+// Timing edit
+static TextWidget timing_step_w = {0, 16, 128, 8, 16, 1, ALIGN_LEFT};
+static TextWidget timing_gate_w = {0, 32, 128, 8, 32, 1, ALIGN_LEFT};
+static TextWidget timing_ratchets_w = {0, 40, 128, 8, 40, 1, ALIGN_LEFT};
+static TextWidget timing_offset_w = {0, 48, 128, 8, 48, 1, ALIGN_LEFT};
+// Pattern select
+static TextWidget pattern_slot_w = {48, 16, 32, 32, 24, 3, ALIGN_CENTER};
+static TextWidget chain_info_w = {0, 48, 128, 8, 48, 1, ALIGN_CENTER};
+static TextWidget slot_mode_w = {0, 56, 128, 8, 56, 1, ALIGN_CENTER};
+
+static TextWidget *const text_widgets[] = {
+    &bpm_value_w,  &bpm_slot_w,     &song_w,         &edit_step_info_w,
+    &note_step_w,  &note_cv_b_w,    &note_gate_w,    &note_value_w,
+    &timing_step_w, &timing_gate_w, &timing_ratchets_w, &timing_offset_w,
+    &pattern_slot_w, &chain_info_w, &slot_mode_w};
+static GridWidget *const grid_widgets[] = {&play_grid_w, &edit_grid_w};
+
+enum Screen : uint8_t {
+  SCREEN_NONE,
+  SCREEN_MAIN,
+  SCREEN_EDIT_STEP,
+  SCREEN_EDIT_NOTE,
+  SCREEN_EDIT_TIMING,
+  SCREEN_PATTERN_SELECT
+};
+static Screen active_screen = SCREEN_NONE;
 
-  if (!first_draw) {
-    ui_edit_step_prev_step = selected_step;
-    ui_edit_step_prev_note = note;
+// Switch screens: clears the framebuffer, invalidates every widget and
+// draws the static labels of the new screen.
+static void enter_screen(Screen screen) {
+  if (active_screen == screen)
+    return;
+  active_screen = screen;
+  ssd1306_clear_fb();
+  for (TextWidget *w : text_widgets)
+    w->valid = false;
+  for (GridWidget *g : grid_widgets)
+    g->valid = false;
+
+  switch (screen) {
+  case SCREEN_MAIN:
+    draw_scaled_text(0, 0, "BPM:", 2);
+    break;
+  case SCREEN_EDIT_STEP:
+    ui_draw_text(0, 0, "STEP SELECT");
+    break;
+  case SCREEN_EDIT_NOTE:
+    ui_draw_text(0, 0, "NOTE EDIT");
+    break;
+  case SCREEN_EDIT_TIMING:
+    ui_draw_text(0, 0, "TIMING EDIT");
+    break;
+  case SCREEN_PATTERN_SELECT:
+    ui_draw_text(22, 0, "PATTERN SELECT");
+    break;
+  default:
+    break;
   }
+}
 
-  ssd1306_update();
+void ui_clear() {
+  ssd1306_clear_fb();
+  active_screen = SCREEN_NONE;
 }
 
-void ui_show_edit_note(uint32_t step, uint8_t note) {
-  bool gate_on = seq_get_gate_enabled(step);
-  bool first_draw = (ui_edit_note_prev_note == 255);
+void ui_show_bpm(uint32_t bpm, uint8_t pattern_slot, bool blink_slot) {
+  enter_screen(SCREEN_MAIN);
+
+  char buf[16];
+  snprintf(buf, sizeof(buf), "%u", (unsigned)bpm);
+  text_widget_set(bpm_value_w, buf);
+
+  // Pattern slot on right side (P:0-63) - hidden while blinking
+  if (blink_slot)
+    buf[0] = '\0';
+  else
+    snprintf(buf, sizeof(buf), "P:%d", pattern_slot);
+  text_widget_set(bpm_slot_w, buf);
+
+  // Song position while a chain plays.
+  if (seq_chain_active())
+    snprintf(buf, sizeof(buf), "SONG %u/%u", (unsigned)seq_chain_position() + 1,
+             (unsigned)seq_chain_length());
+  else
+    buf[0] = '\0';
+  text_widget_set(song_w, buf);
+}
 
-  if (first_draw) {
-    ssd1306_clear_fb();
-    ui_draw_text(0, 0, "NOTE EDIT");
+void ui_show_steps(uint32_t current_step, uint32_t steps) {
+  if (steps == 0)
+    return;
+  enter_screen(SCREEN_MAIN);
+
+  // Follow the play head's page; page 0 while stopped.
+  uint32_t base = current_step < steps ? grid_page_base(current_step) : 0;
+  uint8_t cells[GRID_CELLS];
+  for (uint32_t i = 0; i < GRID_CELLS; ++i) {
+    uint32_t step = base + i;
+    uint8_t state = 0;
+    if (step < steps) {
+      state |= CELL_VISIBLE;
+      if (step == current_step)
+        state |= CELL_ACTIVE;
+      if (seq_get_gate_enabled(step))
+        state |= CELL_GATE;
+    }
+    cells[i] = state;
   }
+  grid_widget_set(play_grid_w, cells);
+}
 
-  if (first_draw || ui_edit_note_prev_step != step) {
-    clear_region(0, 16, 128, 8);
-    char buf[32];
-    sprintf(buf, "Step: %02d", step + 1);
-    ui_draw_text(0, 2, buf);
+void ui_show_edit_step(uint32_t selected_step, uint8_t note) {
+  enter_screen(SCREEN_EDIT_STEP);
+
+  uint32_t base = grid_page_base(selected_step);
+  uint8_t cells[GRID_CELLS];
+  for (uint32_t i = 0; i < GRID_CELLS; ++i) {
+    uint8_t state = CELL_VISIBLE;
+    if (base + i == selected_step)
+      state |= CELL_ACTIVE;
+    if (seq_get_gate_enabled(base + i))
+      state |= CELL_GATE;
+    cells[i] = state;
   }
+  grid_widget_set(edit_grid_w, cells);
 
-  if (first_draw || ui_edit_note_prev_gate != gate_on) {
-    clear_region(0, 32, 128, 8);
-    char buf[32];
-    sprintf(buf, "Gate: %s", gate_on ? "ON" : "OFF");
-    ui_draw_text(0, 4, buf);
-  }
+  char buf[32];
+  char note_str[8];
+  note_to_string(note, note_str);
+  if (seq_get_track() == 0)
+    snprintf(buf, sizeof(buf), "T1 Step:%02u Note:%s",
+             (unsigned)selected_step + 1, note_str);
+  else
+    snprintf(buf, sizeof(buf), "T%u Step:%02u Gate:%s",
+             (unsigned)seq_get_track() + 1, (unsigned)selected_step + 1,
+             seq_get_gate_enabled(selected_step) ? "ON" : "OFF");
+  text_widget_set(edit_step_info_w, buf);
+}
 
-  if (first_draw || ui_edit_note_prev_note != note) {
-    clear_region(0, 40, 128, 24);
-    char buf[32];
-    char note_str[8];
-    note_to_string(note, note_str);
-    sprintf(buf, ">> %s <<", note_str);
+void ui_show_edit_note(uint32_t step, uint8_t note) {
+  enter_screen(SCREEN_EDIT_NOTE);
 
-    int text_width = strlen(buf) * 6 * 2;
-    int center_x = (128 - text_width) / 2;
-    draw_scaled_text(center_x, 47, buf, 2);
-  }
+  char buf[32];
+  snprintf(buf, sizeof(buf), "Step: %02u", (unsigned)step + 1);
+  text_widget_set(note_step_w, buf);
 
-  ui_edit_note_prev_note = note;
-  ui_edit_note_prev_gate = gate_on;
-  ui_edit_note_prev_step = step;
+  snprintf(buf, sizeof(buf), "CV B: %u", (unsigned)seq_get_cv_b(step));
+  text_widget_set(note_cv_b_w, buf);
 
-  ssd1306_update();
-}
+  snprintf(buf, sizeof(buf), "Gate: %s",
+           seq_get_gate_enabled(step) ? "ON" : "OFF");
+  text_widget_set(note_gate_w, buf);
 
-void ui_show_pattern_select(uint8_t slot) {
-  bool first_draw = (ui_pattern_select_prev_slot == -1);
+  char note_str[8];
+  note_to_string(note, note_str);
+  snprintf(buf, sizeof(buf), ">> %s <<", note_str);
+  text_widget_set(note_value_w, buf);
+}
 
-  if (first_draw) {
-    clear_region(0, 0, 128, 64);
-    ui_draw_text(22, 0, "PATTERN SELECT");
-    ui_draw_text(36, 7, "LOAD/SAVE");
-  }
+void ui_show_edit_timing(uint32_t step, TimingField field) {
+  enter_screen(SCREEN_EDIT_TIMING);
 
-  if (first_draw || ui_pattern_select_prev_slot != (int8_t)slot) {
-    clear_region(48, 16, 32, 32);
-    char slot_char = '0' + slot;
-    draw_scaled_char(56, 24, slot_char, 3);
-  }
+  char buf[32];
+  snprintf(buf, sizeof(buf), "T%u Step:%02u Gate:%s",
+           (unsigned)seq_get_track() + 1, (unsigned)step + 1,
+           seq_get_gate_enabled(step) ? "ON" : "OFF");
+  text_widget_set(timing_step_w, buf);
+
+  // '>' marks the field the encoder changes.
+  snprintf(buf, sizeof(buf), "%cLength: %u%%",
+           field == TIMING_GATE_LENGTH ? '>' : ' ',
+           (unsigned)seq_get_gate_length(step));
+  text_widget_set(timing_gate_w, buf);
+
+  snprintf(buf, sizeof(buf), "%cRatchet: x%u",
+           field == TIMING_RATCHETS ? '>' : ' ',
+           (unsigned)seq_get_ratchets(step));
+  text_widget_set(timing_ratchets_w, buf);
+
+  snprintf(buf, sizeof(buf), "%cShift: %+d%%", field == TIMING_OFFSET ? '>' : ' ',
+           (int)seq_get_offset(step));
+  text_widget_set(timing_offset_w, buf);
+}
 
-  ui_pattern_select_prev_slot = slot;
-  ssd1306_update();
+void ui_show_pattern_select(uint8_t slot, bool hide_slot, bool save_failed) {
+  enter_screen(SCREEN_PATTERN_SELECT);
+
+  char buf[4] = {0};
+  if (!hide_slot)
+    snprintf(buf, sizeof(buf), "%u", (unsigned)slot);
+  text_widget_set(pattern_slot_w, buf);
+
+  // Chain length and its last entry.
+  char info[24] = "CHAIN EMPTY";
+  uint8_t length = seq_chain_length();
+  uint8_t last_slot, repeats;
+  if (save_failed)
+    snprintf(info, sizeof(info), "SAVE FAILED");
+  else if (length > 0 && seq_chain_entry((uint8_t)(length - 1), &last_slot, &repeats))
+    snprintf(info, sizeof(info), "CHAIN %u: ..%ux%u", (unsigned)length,
+             (unsigned)last_slot, (unsigned)repeats);
+  text_widget_set(chain_info_w, info);
+
+  // The EEPROM holds far fewer pages than the slots add up to.
+  text_widget_set(slot_mode_w, seq_can_save(slot) ? "LOAD/SAVE" : "LOAD ONLY");
 }
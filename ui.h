@@ -8,13 +8,19 @@ void ui_init();
 // Boot animation (16 steps wave + pulsing effect)
 void ui_boot_animation();
 
+// The ui_show_* functions below are backed by retained widgets: they redraw
+// only the parts whose value changed since the last call, into the
+// framebuffer. Nothing reaches the panel until ui_commit().
+
 // Clear display framebuffer
 void ui_clear();
 
-// Immediately update displayed BPM value and pattern slot (non-blocking)
+// Update displayed BPM value and pattern slot, plus the song position while
+// a chain plays
 void ui_show_bpm(uint32_t bpm, uint8_t pattern_slot, bool blink_slot = false);
 
-// Display 16-step grid (current_step in [0..steps-1]).
+// Display 16-step grid (current_step in [0..steps-1]) for the page of the
+// pattern holding the current step, page 0 when current_step >= steps.
 // Shows 8 squares on top row and 8 on bottom; fills the current step square.
 void ui_show_steps(uint32_t current_step, uint32_t steps);
 
@@ -24,10 +30,56 @@ void ui_show_edit_step(uint32_t selected_step, uint8_t note);
 // Display edit mode: note editing
 void ui_show_edit_note(uint32_t step, uint8_t note);
 
-// Display pattern select mode (slot 0-9)
-void ui_show_pattern_select(uint8_t slot);
+// Display edit mode: step timing of the selected track, with the field the
+// encoder changes marked
+enum TimingField : uint8_t {
+  TIMING_GATE_LENGTH,
+  TIMING_RATCHETS,
+  TIMING_OFFSET,
+  TIMING_FIELDS
+};
+void ui_show_edit_timing(uint32_t step, TimingField field);
+
+// Display pattern select mode (slot 0-63), the song chain summary and
+// whether the edited pattern can still be saved to the slot; hide_slot
+// blanks the slot digit (save confirmation blink); save_failed replaces the
+// chain line with a failure notice.
+void ui_show_pattern_select(uint8_t slot, bool hide_slot = false, bool save_failed = false);
 
 // Low-level drawing functions for custom animations
 void clear_region(int x, int y, int w, int h);
 void draw_scaled_char(int x0, int y0, char c, int scale);
+
+// Queue a DMA flush of the dirty regions and return immediately. Drawing into
+// the framebuffer may continue while the previous frame is transmitted.
+// Bypasses the frame-rate cap; regular screens go through ui_commit().
 void ssd1306_update();
+
+// Frame commit point: call once per main-loop iteration. Starts a single
+// flush of everything drawn since the last frame if the frame interval has
+// elapsed and the previous frame is done. Returns true if a flush started.
+bool ui_commit();
+
+// Cap for ui_commit() (frames per second, default 30).
+void ui_set_frame_rate(uint32_t fps);
+
+// True while a frame is queued or still being transmitted.
+bool ui_flush_busy();
+
+// Block until all queued display traffic has been sent.
+void ui_flush_wait();
+
+// Flush accounting: bytes written to the display (control bytes included).
+// Call ui_flush_stats_tick() once per clock tick to latch the count.
+void ui_flush_stats_tick();
+uint32_t ui_flush_bytes_last_tick();
+uint32_t ui_flush_bytes_max_tick();
+
+// Flush timing: duration of the init command stream and wire time of the
+// most recently completed frame, in microseconds.
+uint32_t ui_init_time_us();
+uint32_t ui_last_frame_time_us();
+
+// Console commands: 'd' prints the flush timings and the frame cap, 'f'
+// steps the cap through 15, 30 and 60 fps. Returns true if `c` was handled.
+bool ui_command(int c);